@@ -11,11 +11,29 @@ CONFIG += c++17
 SOURCES += \
     graphview.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    routebatch.cpp \
+    routecache.cpp \
+    routefile.cpp \
+    routegrid.cpp \
+    routehierarchy.cpp \
+    routenetwork.cpp \
+    routeraptor.cpp \
+    routesearch.cpp \
+    routesnapshot.cpp
 
 HEADERS += \
     graphview.h \
-    mainwindow.h
+    mainwindow.h \
+    routebatch.h \
+    routecache.h \
+    routefile.h \
+    routegrid.h \
+    routehierarchy.h \
+    routenetwork.h \
+    routeraptor.h \
+    routesearch.h \
+    routesnapshot.h
 
 FORMS += \
     mainwindow.ui
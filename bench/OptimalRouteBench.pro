@@ -0,0 +1,28 @@
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = OptimalRouteBench
+
+# Times the routing core on a generated network; nothing here needs widgets.
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../routebatch.cpp \
+    ../routecache.cpp \
+    ../routegrid.cpp \
+    ../routehierarchy.cpp \
+    ../routenetwork.cpp \
+    ../routeraptor.cpp \
+    ../routesearch.cpp
+
+HEADERS += \
+    ../routebatch.h \
+    ../routecache.h \
+    ../routegrid.h \
+    ../routehierarchy.h \
+    ../routenetwork.h \
+    ../routeraptor.h \
+    ../routesearch.h
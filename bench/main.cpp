@@ -0,0 +1,382 @@
+#include "routenetwork.h"
+#include "routesearch.h"
+#include "routehierarchy.h"
+#include "routebatch.h"
+#include "routeraptor.h"
+#include "routecache.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <queue>
+#include <cmath>
+#include <random>
+
+#define GRID_STEP 50
+#define INF 1e18
+
+/*** benchmark start ***/
+namespace{
+struct Query{
+    int S;
+    int T;
+};
+
+// Adds about stop_count stops on a square grid GRID_STEP apart and lines
+// over them. Each line wanders from a random stop to neighbouring ones until
+// it would run into itself or reaches its length. Everything is drawn from
+// seed, so the same arguments give the same network on every machine.
+// Returns the stops some line serves.
+std::vector<int> generate(RouteNetwork *net, int stop_count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    int side = qMax(int(std::ceil(std::sqrt(double(stop_count)))), 2);
+    int line_count = qMax(side * side / 8, 1);
+    for(int r = 0; r < side; r++){
+        for(int c = 0; c < side; c++){
+            net->addStop(c * GRID_STEP, r * GRID_STEP);
+        }
+    }
+    std::vector<int> served;
+    std::vector<int> visit(size_t(side) * side, -1);
+    const int dr[4] = {0, 1, 0, -1};
+    const int dc[4] = {1, 0, -1, 0};
+    for(int line = 0; line < line_count; line++){
+        int length = 20 + rng() % 21;
+        int r = rng() % side;
+        int c = rng() % side;
+        int dir = rng() % 4;
+        std::vector<int> stops;
+        for(int k = 0; k < length; k++){
+            int cell = r * side + c;
+            if(visit[cell] < 0)served.push_back(cell);
+            visit[cell] = line;
+            stops.push_back(cell);
+            if(rng() % 10 >= 7)dir = (dir + (rng() % 2 == 0 ? 1 : 3)) % 4;
+            int nr = r + dr[dir];
+            int nc = c + dc[dir];
+            if(nr < 0 || nr >= side || nc < 0 || nc >= side){
+                dir = (dir + 2) % 4;
+                nr = r + dr[dir];
+                nc = c + dc[dir];
+            }
+            if(visit[nr * side + nc] == line)break;
+            r = nr;
+            c = nc;
+        }
+        net->addLine(1 + rng() % 4, 1 + rng() % 5, 20 + rng() % 81, stops);
+    }
+    return served;
+}
+
+// Pairs of distinct stops drawn from seed.
+std::vector<Query> queries(const std::vector<int> &stops, int count, unsigned seed)
+{
+    std::mt19937 rng(seed + 1);
+    std::vector<Query> ans;
+    while(int(ans.size()) < count && stops.size() > 1){
+        int S = stops[rng() % stops.size()];
+        int T = stops[rng() % stops.size()];
+        if(S != T)ans.push_back(Query{S, T});
+    }
+    return ans;
+}
+
+typedef std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > MinHeap;
+
+// The layout the graph had before it was compressed: one vector of out
+// edges and one of in edges per vertex.
+struct Nested{
+    std::vector<std::vector<std::pair<int, double> > > g;
+    std::vector<std::vector<int> > g_r;
+};
+
+void nest(const RouteNetwork::Graph &csr, Nested *nested)
+{
+    int tot_node = csr.offset.size() - 1;
+    nested->g.assign(tot_node, std::vector<std::pair<int, double> >());
+    nested->g_r.assign(tot_node, std::vector<int>());
+    for(int u = 0; u < tot_node; u++){
+        for(int i = csr.offset[u]; i < csr.offset[u + 1]; i++){
+            nested->g[u].push_back(std::make_pair(csr.target[i], csr.weight[i]));
+            nested->g_r[csr.target[i]].push_back(u);
+        }
+    }
+}
+
+void dijkstra(const RouteNetwork::Graph &g, int S, std::vector<double> &dis)
+{
+    dis.assign(g.offset.size() - 1, INF);
+    MinHeap q;
+    dis[S] = 0;
+    q.push(std::make_pair(0, S));
+    while(!q.empty()){
+        std::pair<double, int> p = q.top();
+        q.pop();
+        int u = p.second;
+        if(p.first > dis[u])continue;
+        for(int i = g.offset[u]; i < g.offset[u + 1]; i++){
+            int v = g.target[i];
+            if(dis[v] > dis[u] + g.weight[i]){
+                dis[v] = dis[u] + g.weight[i];
+                q.push(std::make_pair(dis[v], v));
+            }
+        }
+    }
+}
+
+void dijkstra(const Nested &g, int S, std::vector<double> &dis)
+{
+    dis.assign(g.g.size(), INF);
+    MinHeap q;
+    dis[S] = 0;
+    q.push(std::make_pair(0, S));
+    while(!q.empty()){
+        std::pair<double, int> p = q.top();
+        q.pop();
+        int u = p.second;
+        if(p.first > dis[u])continue;
+        for(const std::pair<int, double> &e : g.g[u]){
+            if(dis[e.first] > dis[u] + e.second){
+                dis[e.first] = dis[u] + e.second;
+                q.push(std::make_pair(dis[e.first], e.first));
+            }
+        }
+    }
+}
+
+// Sum of the cheapest edge weights along path, INF for an empty path.
+double pathWeight(const RouteNetwork::Graph &g, const std::vector<int> &path)
+{
+    if(path.empty())return INF;
+    double w = 0;
+    for(size_t k = 0; k + 1 < path.size(); k++){
+        double best = INF;
+        for(int i = g.offset[path[k]]; i < g.offset[path[k] + 1]; i++){
+            if(g.target[i] == path[k + 1])best = qMin(best, g.weight[i]);
+        }
+        w += best;
+    }
+    return w;
+}
+
+// One row of the report: the time of a run over count queries and, when
+// the run gives costs, the largest difference from plain Dijkstra. The
+// searches of RouteSearch add up fixed-point weights rounded up, so theirs
+// is the rounding along the route. Two answers that disagree on whether
+// the end can be reached count as a mismatch.
+class Report{
+public:
+    Report()
+        : out(stdout)
+    {
+        out << QString("%1%2%3%4%5").arg("run", -40).arg("queries", 10).arg("total ms", 12).arg("us/query", 12).arg("max error", 12)
+            << Qt::endl;
+    }
+    void row(const QString &name, int count, qint64 nsecs, double error = -1, int mismatch = 0)
+    {
+        out << QString("%1").arg(name, -40);
+        if(count > 0)out << QString("%1%2%3").arg(count, 10).arg(nsecs / 1e6, 12, 'f', 1).arg(nsecs / 1e3 / count, 12, 'f', 1);
+        else out << QString("%1%2").arg("", 10).arg(nsecs / 1e6, 12, 'f', 1);
+        if(error >= 0)out << QString("%1").arg(error, 12, 'g', 3);
+        if(mismatch > 0)out << "  " << mismatch << " unreachable mismatches";
+        out << Qt::endl;
+    }
+
+private:
+    QTextStream out;
+};
+
+// Keeps the largest difference of the costs of one run from the costs of
+// plain Dijkstra.
+struct Error{
+    Error()
+        : error(0),
+          mismatch(0)
+    {
+
+    }
+    void add(double cost, double reference)
+    {
+        if((cost >= INF) != (reference >= INF))mismatch++;
+        else if(reference < INF)error = qMax(error, std::fabs(cost - reference));
+    }
+
+    double error;
+    int mismatch;
+};
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("OptimalRouteBench");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the routing graph and its searches on a generated network.");
+    parser.addHelpOption();
+    QCommandLineOption stops_option("stops", "Stops of the generated grid network.", "count", "5000");
+    QCommandLineOption count_option("count", "Queries per strategy.", "count", "100");
+    QCommandLineOption seed_option("seed", "Seed of the network and the queries.", "seed", "1");
+    parser.addOption(stops_option);
+    parser.addOption(count_option);
+    QCommandLineOption threads_option("threads", "Worker threads of the batch runs, every hardware thread by default.", "count");
+    QCommandLineOption walk_radius_option("walk-radius", "Walking radius between stops, 0 for no footpaths.", "radius", "0");
+    QCommandLineOption walk_speed_option("walk-speed", "Walking speed in units per minute.", "speed", "50");
+    QCommandLineOption routes_option("routes", "Routes asked of the k shortest routes run.", "count", "5");
+    parser.addOption(seed_option);
+    parser.addOption(threads_option);
+    parser.addOption(routes_option);
+    parser.addOption(walk_radius_option);
+    parser.addOption(walk_speed_option);
+    parser.process(a);
+    QTextStream err(stderr);
+    RouteNetwork net;
+    std::vector<int> served = generate(&net, qMax(parser.value(stops_option).toInt(), 4), parser.value(seed_option).toUInt());
+    net.setWalk(parser.value(walk_radius_option).toDouble(), parser.value(walk_speed_option).toDouble());
+    std::vector<Query> list = queries(served, qMax(parser.value(count_option).toInt(), 1), parser.value(seed_option).toUInt());
+    err << net.getStopCount() << " stops, " << net.getLineCount() << " lines, " << int(list.size()) << " queries per strategy" << Qt::endl;
+    RouteBatch batch;
+    int thread_count = parser.isSet(threads_option) ? qMax(parser.value(threads_option).toInt(), 1) : batch.getThreadCount();
+    int route_count = qMax(parser.value(routes_option).toInt(), 1);
+    Report report;
+    QElapsedTimer timer;
+    RouteHierarchy hierarchy[3];
+
+    for(int opt = 0; opt < 3; opt++){
+        QString suffix = QString(", strategy %1").arg(opt);
+        int count = list.size();
+        timer.start();
+        const RouteNetwork::Graph &g = net.getGraph(opt);
+        report.row("compile" + suffix, 0, timer.nsecsElapsed());
+        timer.start();
+        net.getLandmarks(opt);
+        report.row("landmarks" + suffix, 0, timer.nsecsElapsed());
+        if(opt != 0){
+            timer.start();
+            hierarchy[opt].build(&net, opt);
+            report.row("contract" + suffix, 0, timer.nsecsElapsed());
+        }
+        Nested nested;
+        timer.start();
+        nest(g, &nested);
+        report.row("nested vectors" + suffix, 0, timer.nsecsElapsed());
+
+        std::vector<double> reference(count);
+        std::vector<double> dis;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            dijkstra(g, list[k].S, dis);
+            reference[k] = dis[list[k].T];
+        }
+        report.row("dijkstra, compressed" + suffix, count, timer.nsecsElapsed());
+
+        Error layout;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            dijkstra(nested, list[k].S, dis);
+            layout.add(dis[list[k].T], reference[k]);
+        }
+        report.row("dijkstra, nested vectors" + suffix, count, timer.nsecsElapsed(), layout.error, layout.mismatch);
+
+        RouteSearch search;
+        search.setNetwork(&net, opt);
+        std::vector<int> path;
+        Error pruned;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            pruned.add(search.dijkstra(list[k].S, list[k].T), reference[k]);
+        }
+        report.row("dijkstra to target" + suffix, count, timer.nsecsElapsed(), pruned.error, pruned.mismatch);
+
+        Error bidirectional;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            bidirectional.add(search.bidirectional(list[k].S, list[k].T, &path), reference[k]);
+        }
+        report.row("bidirectional" + suffix, count, timer.nsecsElapsed(), bidirectional.error, bidirectional.mismatch);
+
+        Error astar;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            astar.add(search.astar(list[k].S, list[k].T), reference[k]);
+        }
+        report.row("astar" + suffix, count, timer.nsecsElapsed(), astar.error, astar.mismatch);
+
+        if(opt != 0){
+            Error contracted;
+            timer.start();
+            for(int k = 0; k < count; k++){
+                contracted.add(search.hierarchy(hierarchy[opt], list[k].S, list[k].T, &path), reference[k]);
+            }
+            report.row("hierarchy" + suffix, count, timer.nsecsElapsed(), contracted.error, contracted.mismatch);
+        }
+
+        // Every four queries share a start, so the first of each four is
+        // searched to its end and the other three are read off the tree
+        // grown for the repeated start.
+        std::vector<double> shared(count);
+        for(int k = 0; k < count; k++){
+            if(k % 4 == 0)dijkstra(g, list[k].S, dis);
+            shared[k] = dis[list[k].T];
+        }
+        Error cached;
+        RouteTreeCache trees;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            int S = list[k - k % 4].S;
+            if(!trees.route(&net, search, opt, S, list[k].T, &path)){
+                search.dijkstra(S, list[k].T);
+                search.findPath(list[k].T, &path);
+            }
+            cached.add(pathWeight(g, path), shared[k]);
+        }
+        report.row("tree cache" + suffix, count, timer.nsecsElapsed(), cached.error, cached.mismatch);
+
+        Error ranked;
+        std::vector<std::vector<int> > paths;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            paths.clear();
+            search.kShortest(list[k].S, list[k].T, route_count, &paths);
+            ranked.add(paths.empty() ? INF : pathWeight(g, paths[0]), reference[k]);
+        }
+        report.row(QString("kShortest %1").arg(route_count) + suffix, count, timer.nsecsElapsed(), ranked.error, ranked.mismatch);
+
+        RouteRaptor raptor;
+        raptor.setNetwork(&net, opt);
+        std::vector<std::vector<std::pair<int, int> > > routes;
+        timer.start();
+        for(int k = 0; k < count; k++){
+            routes.clear();
+            raptor.query(list[k].S, list[k].T, &routes);
+        }
+        report.row("raptor" + suffix, count, timer.nsecsElapsed());
+    }
+
+    // every query of every strategy in one batch
+    std::vector<RouteBatch::Query> all;
+    for(int opt = 0; opt < 3; opt++){
+        for(const Query &query : list){
+            all.push_back(RouteBatch::Query{opt, query.S, query.T});
+        }
+    }
+    std::vector<std::vector<int> > paths;
+    batch.setNetwork(&net);
+    batch.setThreadCount(1);
+    timer.start();
+    batch.run(all, &paths);
+    report.row("batch, 1 thread", all.size(), timer.nsecsElapsed());
+    batch.setThreadCount(thread_count);
+    timer.start();
+    batch.run(all, &paths);
+    report.row(QString("batch, %1 threads").arg(thread_count), all.size(), timer.nsecsElapsed());
+    for(int opt = 1; opt < 3; opt++){
+        batch.setHierarchy(opt, &hierarchy[opt]);
+    }
+    timer.start();
+    batch.run(all, &paths);
+    report.row(QString("batch with hierarchy, %1 threads").arg(thread_count), all.size(), timer.nsecsElapsed());
+    return 0;
+}
+/*** benchmark end ***/
@@ -0,0 +1,33 @@
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = OptimalRouteCli
+
+# The routing core is shared with the window; nothing here needs widgets.
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../routebatch.cpp \
+    ../routefile.cpp \
+    ../routegrid.cpp \
+    ../routehierarchy.cpp \
+    ../routenetwork.cpp \
+    ../routesearch.cpp \
+    ../routesnapshot.cpp
+
+HEADERS += \
+    ../routebatch.h \
+    ../routefile.h \
+    ../routegrid.h \
+    ../routehierarchy.h \
+    ../routenetwork.h \
+    ../routesearch.h \
+    ../routesnapshot.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
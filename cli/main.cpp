@@ -0,0 +1,393 @@
+#include "routefile.h"
+#include "routenetwork.h"
+#include "routegrid.h"
+#include "routehierarchy.h"
+#include "routebatch.h"
+#include "routesearch.h"
+#include "routesnapshot.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <cstdio>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#define QUERY_BLOCK 65536
+
+/*** command line router start ***/
+// A network file loaded the way the window loads it, straight into the
+// compiled network: stops closer than the snap distance are merged, a stop
+// keeps the last name it is given, and a name shared by several stops
+// stands for the one with the lowest id.
+struct Model{
+    RouteNetwork network;
+    QVector<QString> stop_names;
+    QVector<QPointF> stop_pos;
+    QVector<QString> line_names;
+    QHash<QString, int> stop_index;
+    int duplicates;
+};
+
+static void readText(QFile *file, Model *model)
+{
+    RouteGrid grid;
+    RouteFile::readNetwork(file, [model, &grid](const RouteFile::Record &record){
+        std::vector<int> stops;
+        int last_stop = -1;
+        for(const QPair<QString, QPointF> &p : record.stops){
+            int stop = grid.nearest(p.second.x(), p.second.y(), RouteFile::snapDistance());
+            if(stop < 0){
+                stop = model->network.addStop(p.second.x(), p.second.y());
+                grid.insert(stop, p.second.x(), p.second.y());
+                model->stop_names.push_back(QString());
+                model->stop_pos.push_back(p.second);
+            }
+            model->stop_names[stop] = p.first;
+            if(stop == last_stop)continue;
+            stops.push_back(stop);
+            last_stop = stop;
+        }
+        model->network.addLine(record.price, record.time, record.speed, stops);
+        model->line_names.push_back(record.name);
+    });
+}
+
+// Fills the model from the snapshot of the file when there is a valid one,
+// otherwise from the text, writing a snapshot for the next run.
+static bool loadNetwork(const QString &file_path, Model *model, bool use_snapshot)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        return false;
+    }
+    RouteSnapshot snapshot;
+    if(use_snapshot && snapshot.open(file_path)){
+        snapshot.load(&model->network);
+        model->stop_names.reserve(snapshot.getStopCount());
+        model->stop_pos.reserve(snapshot.getStopCount());
+        model->line_names.reserve(snapshot.getLineCount());
+        for(int i = 0, size = snapshot.getStopCount(); i < size; i++){
+            model->stop_names.push_back(snapshot.getStopName(i));
+            model->stop_pos.push_back(snapshot.getStopPos(i));
+        }
+        for(int i = 0, size = snapshot.getLineCount(); i < size; i++){
+            model->line_names.push_back(snapshot.getLineName(i));
+        }
+    }
+    else{
+        readText(&file, model);
+        if(use_snapshot){
+            QVector<RouteSnapshot::Line> lines;
+            for(int i = 0, size = model->line_names.size(); i < size; i++){
+                const RouteNetwork::Line &line = model->network.getLine(i);
+                lines.push_back(RouteSnapshot::Line{model->line_names[i], line.price, line.time, line.speed, line.stops});
+            }
+            RouteSnapshot::write(file_path, model->stop_pos, model->stop_names, lines);
+        }
+    }
+    file.close();
+    model->duplicates = 0;
+    for(int stop = 0, size = model->stop_names.size(); stop < size; stop++){
+        if(model->stop_index.contains(model->stop_names[stop]))model->duplicates++;
+        else model->stop_index.insert(model->stop_names[stop], stop);
+    }
+    return true;
+}
+
+// Peak resident memory of the process in KiB, or -1 where it is not known.
+static long peakMemory()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0){
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+static QString routeString(Model *model, const std::vector<int> &path, int opt)
+{
+    std::vector<std::pair<int, int> > route;
+    model->network.itinerary(path, &route);
+    QVector<RouteFile::Hop> hops;
+    for(const std::pair<int, int> &p : route){
+        RouteFile::Hop hop;
+        hop.stop = p.first;
+        hop.stop_name = model->stop_names[p.first];
+        hop.pos = model->stop_pos[p.first];
+        hop.line = p.second;
+        hop.line_name = p.second < 0 ? QString() : model->line_names[p.second];
+        hop.price = p.second < 0 ? 0 : model->network.getLine(p.second).price;
+        hop.time = p.second < 0 ? 0 : model->network.getLine(p.second).time;
+        hop.speed = p.second < 0 ? 0 : model->network.getLine(p.second).speed;
+        hops.push_back(hop);
+    }
+    return RouteFile::routeString(hops, opt, model->network.getWalkSpeed());
+}
+
+// One stop name per line; blank lines are skipped and a name no stop has
+// gives -1.
+static bool readStops(const QString &file_path, Model *model, QVector<QByteArray> *names, std::vector<int> *stops)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        return false;
+    }
+    QVector<QByteArray> lines;
+    while(RouteFile::readLines(&file, QUERY_BLOCK, &lines) > 0){
+        for(const QByteArray &line : lines){
+            if(line.isEmpty())continue;
+            names->push_back(line);
+            stops->push_back(model->stop_index.value(QString::fromUtf8(line), -1));
+        }
+    }
+    file.close();
+    return true;
+}
+
+// Writes the totals from every source to every target, source by source,
+// as answers without legs. Returns the number of reachable pairs.
+static qint64 writeMatrix(Model *model, int opt, const QVector<QByteArray> &source_names, const std::vector<int> &sources,
+                          const QVector<QByteArray> &target_names, const std::vector<int> &targets,
+                          RouteFile::Format format, RouteFile::Writer *writer)
+{
+    std::vector<int> rows;
+    std::vector<int> cols;
+    std::vector<int> known_sources;
+    std::vector<int> known_targets;
+    for(int i = 0, size = sources.size(); i < size; i++){
+        rows.push_back(known_sources.size());
+        if(sources[i] >= 0)known_sources.push_back(sources[i]);
+    }
+    for(int j = 0, size = targets.size(); j < size; j++){
+        cols.push_back(known_targets.size());
+        if(targets[j] >= 0)known_targets.push_back(targets[j]);
+    }
+    RouteSearch search;
+    search.setNetwork(&model->network, opt);
+    std::vector<RouteNetwork::Cost> costs;
+    search.matrix(known_sources, known_targets, &costs);
+    std::function<QByteArray(int)> name = [](int){
+        return QByteArray();
+    };
+    RouteFile::Answer answer;
+    answer.opt = opt;
+    answer.cost.reachable = false;
+    answer.cost.price = answer.cost.time = answer.cost.distance = 0;
+    answer.cost.transfer = 0;
+    RouteNetwork::Cost none = answer.cost;
+    qint64 reachable = 0;
+    for(int i = 0, size_i = sources.size(); i < size_i; i++){
+        for(int j = 0, size_j = targets.size(); j < size_j; j++){
+            answer.index = qint64(i) * size_j + j + 1;
+            answer.start = source_names[i];
+            answer.end = target_names[j];
+            answer.S = sources[i];
+            answer.T = targets[j];
+            answer.cost = sources[i] < 0 || targets[j] < 0 ? none : costs[size_t(rows[i]) * known_targets.size() + cols[j]];
+            if(answer.cost.reachable)reachable++;
+            writer->writeAnswer(format, answer, name, name);
+        }
+    }
+    return reachable;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("OptimalRouteCli");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Answers a query file over a network file without opening a window.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("network", "Network file, one path per line.");
+    parser.addPositionalArgument("queries", "Query file, one \"strategy start end\" per line.");
+    parser.addPositionalArgument("output", "Output file, the query file with _routes_output and the extension of the format by default.", "[output]");
+    QCommandLineOption walk_radius_option("walk-radius", "Walking radius between stops, 0 for no footpaths.", "radius", "0");
+    QCommandLineOption walk_speed_option("walk-speed", "Walking speed in units per minute.", "speed", "50");
+    QCommandLineOption preprocess_option("preprocess", "Contract the time strategies before answering.");
+    QCommandLineOption threads_option("threads", "Number of worker threads.", "count");
+    QCommandLineOption format_option("format", "Answer format: text, csv, jsonl or binary.", "format", "text");
+    QCommandLineOption no_snapshot_option("no-snapshot", "Neither read nor write the binary snapshot of the network file.");
+    QCommandLineOption matrix_option("matrix", "Instead of routes, write the totals from every stop named in the query file, one per line, "
+                                     "to every stop named in the targets file under the strategy. Implies csv unless another format is given.", "strategy");
+    QCommandLineOption targets_option("targets", "Stop list of the matrix targets, the query file by default.", "file");
+    parser.addOption(walk_radius_option);
+    parser.addOption(walk_speed_option);
+    parser.addOption(preprocess_option);
+    parser.addOption(threads_option);
+    parser.addOption(no_snapshot_option);
+    parser.addOption(format_option);
+    parser.addOption(matrix_option);
+    parser.addOption(targets_option);
+    parser.process(a);
+    QStringList args = parser.positionalArguments();
+    if(args.size() < 2){
+        parser.showHelp(1);
+    }
+    QTextStream err(stderr);
+    RouteFile::Format format;
+    if(!RouteFile::parseFormat(parser.value(format_option), &format)){
+        err << "Unknown format " << parser.value(format_option) << Qt::endl;
+        return 1;
+    }
+    bool matrix = parser.isSet(matrix_option);
+    bool flag = false;
+    int matrix_opt = parser.value(matrix_option).toInt(&flag);
+    if(matrix){
+        if(!flag || matrix_opt < 0 || matrix_opt > 2){
+            err << "Unknown strategy " << parser.value(matrix_option) << Qt::endl;
+            return 1;
+        }
+        if(!parser.isSet(format_option)){
+            format = RouteFile::Csv;
+        }
+        else if(format == RouteFile::Text){
+            err << "A matrix is written as csv, jsonl or binary" << Qt::endl;
+            return 1;
+        }
+    }
+
+    Model model;
+    model.network.setWalk(parser.value(walk_radius_option).toDouble(), parser.value(walk_speed_option).toDouble());
+    QElapsedTimer timer;
+    timer.start();
+    if(!loadNetwork(args[0], &model, !parser.isSet(no_snapshot_option))){
+        err << "Cannot read network file " << args[0] << Qt::endl;
+        return 1;
+    }
+    err << "Loaded " << model.stop_names.size() << " stops and " << model.line_names.size() << " lines in "
+        << timer.elapsed() << " ms, peak memory " << peakMemory() << " KiB" << Qt::endl;
+    if(model.duplicates > 0){
+        err << model.duplicates << " stops share a name with a stop of lower id" << Qt::endl;
+    }
+
+    QVector<QByteArray> source_names;
+    QVector<QByteArray> target_names;
+    std::vector<int> sources;
+    std::vector<int> targets;
+    if(matrix){
+        QString targets_path = parser.isSet(targets_option) ? parser.value(targets_option) : args[1];
+        if(!readStops(args[1], &model, &source_names, &sources)){
+            err << "Cannot read query file " << args[1] << Qt::endl;
+            return 1;
+        }
+        if(!readStops(targets_path, &model, &target_names, &targets)){
+            err << "Cannot read targets file " << targets_path << Qt::endl;
+            return 1;
+        }
+    }
+    QFile rfile(args[1]);
+    if(!rfile.open(QIODevice::ReadOnly | QIODevice::Text)){
+        err << "Cannot read query file " << args[1] << Qt::endl;
+        return 1;
+    }
+    QString save_path = args.size() > 2 ? args[2] : RouteFile::outputPath(args[1], format);
+    QFile wfile(save_path);
+    if(!wfile.open(format == RouteFile::Binary ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text)){
+        err << "Cannot write output file " << save_path << Qt::endl;
+        return 1;
+    }
+    RouteBatch batch;
+    batch.setNetwork(&model.network);
+    if(parser.isSet(threads_option)){
+        batch.setThreadCount(parser.value(threads_option).toInt());
+    }
+    RouteHierarchy hierarchy[3];
+    if(parser.isSet(preprocess_option)){
+        for(int opt = 1; opt < 3; opt++){
+            hierarchy[opt].build(&model.network, opt);
+            batch.setHierarchy(opt, &hierarchy[opt]);
+        }
+    }
+
+    // The query file is answered QUERY_BLOCK lines at a time through one
+    // buffered writer, so memory does not grow with the file.
+    RouteFile::Writer writer(&wfile);
+    writer.writeHeader(format);
+    if(matrix){
+        qint64 reachable = writeMatrix(&model, matrix_opt, source_names, sources, target_names, targets, format, &writer);
+        rfile.close();
+        if(!writer.flush()){
+            err << "Cannot write output file " << save_path << Qt::endl;
+            return 1;
+        }
+        wfile.close();
+        QTextStream(stdout) << reachable << " of " << qint64(sources.size()) * qint64(targets.size())
+                            << " pairs reachable, written to " << save_path << Qt::endl;
+        return 0;
+    }
+    std::function<QByteArray(int)> stop_name = [&model](int stop){
+        return model.stop_names[stop].toUtf8();
+    };
+    std::function<QByteArray(int)> line_name = [&model](int line){
+        return model.line_names[line].toUtf8();
+    };
+    RouteFile::Answer answer;
+    QVector<QByteArray> lines;
+    QVector<QByteArray> start_names;
+    QVector<QByteArray> end_names;
+    std::vector<RouteBatch::Query> queries;
+    std::vector<std::vector<int> > paths;
+    qint64 total = 0;
+    qint64 answered = 0;
+    while(RouteFile::readLines(&rfile, QUERY_BLOCK, &lines) > 0){
+        queries.assign(lines.size(), RouteBatch::Query());
+        start_names.fill(QByteArray(), lines.size());
+        end_names.fill(QByteArray(), lines.size());
+        for(int i = 0, size = lines.size(); i < size; i++){
+            RouteBatch::Query &query = queries[i];
+            query.opt = -1;
+            query.S = query.T = -1;
+            RouteFile::Query line;
+            if(!RouteFile::parseQuery(QString::fromUtf8(lines[i]), &line))continue;
+            start_names[i] = line.start.toUtf8();
+            end_names[i] = line.end.toUtf8();
+            query.opt = line.opt;
+            query.S = model.stop_index.value(line.start, -1);
+            query.T = model.stop_index.value(line.end, -1);
+        }
+        batch.run(queries, &paths);
+        for(int i = 0, size = lines.size(); i < size; i++){
+            if(!paths[i].empty()){
+                answered++;
+            }
+            if(format != RouteFile::Text){
+                if(lines[i].isEmpty())continue;
+                answer.index = total + i + 1;
+                answer.opt = queries[i].opt;
+                answer.start = start_names[i];
+                answer.end = end_names[i];
+                answer.S = queries[i].S;
+                answer.T = queries[i].T;
+                RouteFile::answer(&model.network, paths[i], &answer);
+                writer.writeAnswer(format, answer, stop_name, line_name);
+                continue;
+            }
+            lines[i].append('\n');
+            writer.write(lines[i]);
+            if(!paths[i].empty()){
+                writer.write(routeString(&model, paths[i], queries[i].opt));
+            }
+        }
+        total += lines.size();
+    }
+    rfile.close();
+    if(!writer.flush()){
+        err << "Cannot write output file " << save_path << Qt::endl;
+        return 1;
+    }
+    wfile.close();
+    QTextStream(stdout) << answered << " of " << total << " queries answered, written to " << save_path << Qt::endl;
+    return 0;
+}
+/*** command line router end ***/
@@ -4,11 +4,13 @@
 #include <QWheelEvent>
 #include <QtMath>
 #include <queue>
+#include <algorithm>
 #include <QFile>
 #include <QFileInfo>
 #include <QProgressDialog>
 #include <QCoreApplication>
 #include <QMessageBox>
+#include <QMap>
 
 #define debug1 printf("run1\n");fflush(stdout);
 #define debug2 printf("run2\n");fflush(stdout);
@@ -21,6 +23,7 @@
 #define NODE_COLOR (is_highlight ? Qt::red : Qt::black)
 #define EDGE_WIDTH 5
 #define HIGHLIGHT_EDGE_WIDTH 5 * (3 + 3 * qLn(1 / GlobalVar::graph_view->getView_scale()))
+#define QUERY_BLOCK 65536
 
 
 /*** ui item functions rewrite start ***/
@@ -75,7 +78,8 @@ void NameLineEdit::focusOutEvent(QFocusEvent *event)
 
 PropertySpinBox::PropertySpinBox(QWidget *parent)
     : QDoubleSpinBox(parent),
-      property_value(nullptr)
+      property_value(nullptr),
+      path(nullptr)
 {
 
 }
@@ -83,6 +87,7 @@ PropertySpinBox::PropertySpinBox(QWidget *parent)
 void PropertySpinBox::clear()
 {
     property_value = nullptr;
+    path = nullptr;
 }
 
 void PropertySpinBox::setPropertyValue(qreal *newPropertyValue)
@@ -90,10 +95,23 @@ void PropertySpinBox::setPropertyValue(qreal *newPropertyValue)
     property_value = newPropertyValue;
 }
 
+void PropertySpinBox::setPath(Path *path)
+{
+    this->path = path;
+}
+
 void PropertySpinBox::focusOutEvent(QFocusEvent *event)
 {
     Q_UNUSED(event);
-    *property_value = value();
+    if(property_value != nullptr && *property_value != value()){
+        *property_value = value();
+        if(Path::paths.contains(path)){
+            GraphAlgorithm::updatePath(path);
+        }
+        else{
+            GraphAlgorithm::invalidate();
+        }
+    }
     QDoubleSpinBox::focusOutEvent(event);
 }
 
@@ -153,18 +171,35 @@ QTreeWidget *GlobalVar::output_list = nullptr;
 /**          Node              **/
 
 QSet<Node *> Node::nodes = QSet<Node *>();
+QVector<Node *> Node::id_nodes = QVector<Node *>();
 int Node::name_count = 0;
+QVector<int> Node::free_ids = QVector<int>();
+QMultiMap<QString, Node *> Node::name_index = QMultiMap<QString, Node *>();
+QSet<Node *> Node::shown_nodes = QSet<Node *>();
+RouteGrid Node::grid = RouteGrid();
 
 Node::Node(const QPointF &pos)
-    : name(QString("站点 ").append(QString::number(++name_count))),
+    : id(-1),
+      name(QString("站点 ").append(QString::number(++name_count))),
       is_highlight(true)
 {
+    if(free_ids.empty()){
+        id = id_nodes.size();
+        id_nodes.push_back(this);
+    }
+    else{
+        id = free_ids.back();
+        free_ids.pop_back();
+        id_nodes[id] = this;
+    }
     setPos(pos);
     setZValue(2);
     setText(name);
     nodes.insert(this);
+    name_index.insert(name, this);
+    grid.insert(id, pos.x(), pos.y());
     GlobalVar::node_list->addItem(this);
-    setHidden(!text().contains(GlobalVar::node_filter->text()));
+    applyFilter();
     if(GlobalVar::graph_view->getEnableScene()){
         GlobalVar::scene->addItem(this);
     }
@@ -173,6 +208,11 @@ Node::Node(const QPointF &pos)
 Node::~Node()
 {
     nodes.remove(this);
+    name_index.remove(name, this);
+    shown_nodes.remove(this);
+    grid.remove(id);
+    id_nodes[id] = nullptr;
+    free_ids.push_back(id);
     if(this->scene() == GlobalVar::scene){
         GlobalVar::scene->removeItem(this);
     }
@@ -184,6 +224,11 @@ void Node::resetup()
         delete node;
     }
     nodes.clear();
+    id_nodes.clear();
+    free_ids.clear();
+    name_index.clear();
+    shown_nodes.clear();
+    grid.clear();
     name_count = 0;
 }
 
@@ -244,6 +289,11 @@ int Node::getPathCount() const
     return paths.size();
 }
 
+int Node::getId() const
+{
+    return id;
+}
+
 QString Node::getName() const
 {
     return name;
@@ -256,9 +306,14 @@ QString *Node::getNamePointer()
 
 void Node::setName(const QString &newName)
 {
+    if(name != newName){
+        name_index.remove(name, this);
+        name_index.insert(newName, this);
+        GlobalVar::graph_view->clearRouteCache();
+    }
     name = newName;
     setText(name);
-    setHidden(!text().contains(GlobalVar::node_filter->text()));
+    applyFilter();
     for(PathNode *pathnode : paths){
         pathnode->setText(0, name);
         setHidden(!pathnode->text(0).contains(GlobalVar::path_filter->text()));
@@ -267,6 +322,85 @@ void Node::setName(const QString &newName)
     GlobalVar::graph_view->showStartEndNode();
 }
 
+static bool idLess(Node *a, Node *b)
+{
+    return a->getId() < b->getId();
+}
+
+// Every node named name, lowest id first, so that a name shared by
+// several stops always resolves to the same one.
+QList<Node *> Node::findName(const QString &name)
+{
+    QList<Node *> res = name_index.values(name);
+    std::sort(res.begin(), res.end(), idLess);
+    return res;
+}
+
+QList<Node *> Node::findPrefix(const QString &prefix)
+{
+    QList<Node *> res;
+    for(QMultiMap<QString, Node *>::const_iterator it = name_index.lowerBound(prefix); it != name_index.constEnd() && it.key().startsWith(prefix); it++){
+        res.push_back(it.value());
+    }
+    return res;
+}
+
+QStringList Node::getDuplicateNames()
+{
+    QStringList res;
+    for(const QString &name : name_index.uniqueKeys()){
+        if(name_index.count(name) > 1)res.push_back(name);
+    }
+    return res;
+}
+
+// Shows the nodes whose name starts with prefix. Only the nodes shown by
+// the last filter and the name range of the new prefix are touched.
+void Node::filter(const QString &prefix)
+{
+    QSet<Node *> shown;
+    for(Node *node : findPrefix(prefix)){
+        shown.insert(node);
+    }
+    foreach(Node *node, shown_nodes){
+        if(!shown.contains(node))node->setHidden(true);
+    }
+    foreach(Node *node, shown){
+        node->setHidden(false);
+    }
+    shown_nodes = shown;
+}
+
+Node *Node::findNearest(const QPointF &pos, qreal limit)
+{
+    int id = grid.nearest(pos.x(), pos.y(), limit);
+    return id < 0 ? nullptr : id_nodes[id];
+}
+
+// The node drawn under pos. Taken from the grid rather than the scene so
+// that it also works while the scene is disabled.
+Node *Node::findAt(const QPointF &pos)
+{
+    Node *node = findNearest(pos);
+    if(node == nullptr)return nullptr;
+    QPointF delta = node->pos() - pos;
+    if(qSqrt(delta.x() * delta.x() + delta.y() * delta.y()) > node->getRadius())return nullptr;
+    return node;
+}
+
+qreal Node::getRadius() const
+{
+    return NODE_RADII + NODE_WIDTH / 2.0;
+}
+
+void Node::applyFilter()
+{
+    bool flag = name.startsWith(GlobalVar::node_filter->text());
+    setHidden(!flag);
+    if(flag)shown_nodes.insert(this);
+    else shown_nodes.remove(this);
+}
+
 void Node::setIs_highlight(bool newIs_highlight)
 {
     is_highlight = newIs_highlight;
@@ -438,10 +572,13 @@ PathNode::PathNode(Path *path, Node *node, Edge *edge)
 }
 
 QSet<Path *> Path::paths = QSet<Path *>();
+QVector<Path *> Path::id_paths = QVector<Path *>();
 int Path::name_count = 0;
+QVector<int> Path::free_ids = QVector<int>();
 
 Path::Path(const QColor &color)
-    : name(QString("线路 ").append(QString::number(++name_count))),
+    : id(-1),
+      name(QString("线路 ").append(QString::number(++name_count))),
       price(1),
       time(10),
       speed(1),
@@ -453,12 +590,23 @@ Path::Path(const QColor &color)
     GlobalVar::path_list->addTopLevelItem(this);
     setHidden(!text(0).contains(GlobalVar::path_filter->text()));
     paths.insert(this);
+    if(free_ids.empty()){
+        id = id_paths.size();
+        id_paths.push_back(this);
+    }
+    else{
+        id = free_ids.back();
+        free_ids.pop_back();
+        id_paths[id] = this;
+    }
 }
 
 Path::~Path()
 {
     clear();
     paths.remove(this);
+    id_paths[id] = nullptr;
+    free_ids.push_back(id);
 }
 
 void Path::resetup()
@@ -467,6 +615,8 @@ void Path::resetup()
         delete path;
     }
     paths.clear();
+    id_paths.clear();
+    free_ids.clear();
     name_count = 0;
 }
 
@@ -495,7 +645,7 @@ void Path::clear()
 
 void Path::addNode(const QPointF &pos, const QString &name)
 {
-    Node *node = dynamic_cast<Node *>(GlobalVar::scene->itemAt(pos, QTransform()));
+    Node *node = Node::findAt(pos);
     if(!pathnodes.empty() && node == pathnodes.back()->node)return;
     if(node == nullptr)node = new Node(pos);
     if(!name.isEmpty())node->setName(name);
@@ -509,6 +659,7 @@ void Path::addNode(const QPointF &pos, const QString &name)
         edge->insertPath(this);
     }
     pathnodes.push_back(new PathNode(this, node, edge));
+    GraphAlgorithm::invalidate();
 }
 
 void Path::showProperty()
@@ -520,10 +671,18 @@ void Path::showProperty()
     GlobalVar::pathname_edit->setPath(this);
     GlobalVar::price_box->setValue(price);
     GlobalVar::price_box->setPropertyValue(&price);
+    GlobalVar::price_box->setPath(this);
     GlobalVar::time_box->setValue(time);
     GlobalVar::time_box->setPropertyValue(&time);
+    GlobalVar::time_box->setPath(this);
     GlobalVar::speed_box->setValue(speed);
     GlobalVar::speed_box->setPropertyValue(&speed);
+    GlobalVar::speed_box->setPath(this);
+}
+
+int Path::getId() const
+{
+    return id;
 }
 
 void Path::setHighlight()
@@ -548,6 +707,9 @@ QString *Path::getNamePointer()
 
 void Path::setName(const QString &newName)
 {
+    if(name != newName){
+        GlobalVar::graph_view->clearRouteCache();
+    }
     name = newName;
     setText(0, name);
     setHidden(!text(0).contains(GlobalVar::path_filter->text()));
@@ -633,8 +795,12 @@ GraphView::GraphView(QWidget *parent)
       cache_highlight_edges(),
       start_node(nullptr),
       end_node(nullptr),
+      route_size(5),
       have_file_path(false),
-      file_path()
+      file_path(),
+      route_cache(),
+      route_cache_version(0),
+      output_format(RouteFile::Text)
 {
     GlobalVar::scene = &scene;
     GlobalVar::cache_highlight_nodes = &cache_highlight_nodes;
@@ -673,6 +839,7 @@ void GraphView::clear()
     dialog.setValue(60);
     QCoreApplication::processEvents();
     Node::resetup();
+    GraphAlgorithm::invalidate();
     dialog.setValue(90);
     QCoreApplication::processEvents();
     scene.clear();
@@ -727,12 +894,12 @@ void GraphView::test()
 
 QPointF GraphView::posToPix(const QPointF &pos)
 {
-    return QPointF(pos.x() * 50000, -pos.y() * 50000);
+    return RouteFile::posToPix(pos);
 }
 
 QPointF GraphView::pixToPos(const QPointF &pos)
 {
-    return QPointF(pos.x() / 50000, -pos.y() / 50000);
+    return RouteFile::pixToPos(pos);
 }
 
 void GraphView::openFile(const QString &file_path)
@@ -745,90 +912,108 @@ void GraphView::openFile(const QString &file_path)
     }
     have_file_path = true;
     this->file_path = file_path;
-    QStringList lines;
-    while(!file.atEnd()){
-        lines.push_back(file.readLine().trimmed());
+    // The scene is detached while paths are added and only attached again
+    // if the network is small enough to draw.
+    setEnableScene(false);
+    // A snapshot written by an earlier open of the same, unchanged file is
+    // used as it is; otherwise the text is read and a snapshot written.
+    RouteSnapshot snapshot;
+    bool finished;
+    if(snapshot.open(file_path)){
+        finished = openSnapshot(snapshot);
     }
-    if(lines.size() < 1000){
+    else{
+        qint64 file_size = qMax(file.size(), qint64(1));
+        QProgressDialog dialog("打开进度", "取消", 0, 1000, this);
+        dialog.show();
+        finished = RouteFile::readNetwork(&file, [](const RouteFile::Record &record){
+            Path *path = new Path();
+            path->setName(record.name);
+            path->setPrice(record.price);
+            path->setTime(record.time);
+            path->setSpeed(record.speed);
+            Node *last_node = nullptr;
+            for(const QPair<QString, QPointF> &p : record.stops){
+                Node *node = Node::findNearest(p.second, RouteFile::snapDistance());
+                if(node == nullptr)node = new Node(p.second);
+                node->setName(p.first);
+                node->setIs_highlight(true);
+                Edge *edge = nullptr;
+                if(node == last_node)continue;
+                if(last_node != nullptr){
+                    edge = Edge::getEdge(last_node, node);
+                    edge->insertPath(path);
+                    edge->setHighlight_path(path);
+                }
+                path->getPathnodes()->push_back(new PathNode(path, node, edge));
+                last_node = node;
+            }
+        }, [&dialog, file_size](qint64 bytes){
+            dialog.setValue(int(qMin(bytes, file_size) * 1000 / file_size));
+            QCoreApplication::processEvents();
+            return !dialog.wasCanceled();
+        });
+        if(finished){
+            saveSnapshot();
+        }
+    }
+    if(!finished){
+        clear();
+    }
+    else if(Path::paths.size() < 1000){
         setEnableScene(true);
     }
-    else if(lines.size() < 100000){
-        setEnableScene(false);
+    else{
         QMessageBox::warning(this, "提示", "文件过大，将禁用视窗，仍可使用对象管理器或批量查询。");
     }
-    else{
-        setEnableScene(true);
-        QMessageBox::critical(this, "错误", "文件过大。");
-        return;
+//    printf("path size: %d\n",Path::paths.size());
+//    printf("node size: %d\n",Node::nodes.size());
+//    printf("edge size: %d\n",Edge::edges.size());
+//    fflush(stdout);
+    file.close();
+    GraphAlgorithm::invalidate();
+    clearHighlight();
+    setViewAll();
+    viewport()->update();
+    QStringList duplicates = Node::getDuplicateNames();
+    if(!duplicates.empty()){
+        QMessageBox::warning(this, "提示", QString("有%1个站名对应多个站点，批量查询将使用编号最小的站点：").arg(duplicates.size())
+                             + QStringList(duplicates.mid(0, 10)).join("，") + (duplicates.size() > 10 ? "等" : ""));
+    }
+    if(GraphAlgorithm::getPreprocess()){
+        preprocess();
     }
-    QMap<QPair<qreal, qreal>, Node *>map;
-    QProgressDialog dialog("打开进度", "取消", 0, lines.size(), this);
+}
+
+bool GraphView::openSnapshot(const RouteSnapshot &snapshot)
+{
+    int stop_count = snapshot.getStopCount();
+    int line_count = snapshot.getLineCount();
+    QProgressDialog dialog("打开进度", "取消", 0, qMax(stop_count + line_count, 1), this);
     dialog.show();
-    for(int i = 0, size = lines.size(); i < size; i++){
-        dialog.setValue(i);
-        QCoreApplication::processEvents();
-        if(dialog.wasCanceled()){
-            clear();
-            break;
+    QVector<Node *> nodes(stop_count);
+    for(int i = 0; i < stop_count + line_count; i++){
+        if(i % 4096 == 0){
+            dialog.setValue(i);
+            QCoreApplication::processEvents();
+            if(dialog.wasCanceled())return false;
         }
-        QString str = lines[i];
-        QStringList list = str.split("：", Qt::SkipEmptyParts);
-        if(list.size() < 2)continue;
-        QString name = list[0];
-        list = list[1].split("。", Qt::SkipEmptyParts);
-        if(list.size() < 4)continue;
-
-        bool flag = true;
-        QStringList path_list = list[1].split("元", Qt::SkipEmptyParts);
-        if(path_list.size() != 1)continue;
-        qreal price = path_list[0].toDouble(&flag);
-        if(!flag || price < 0 || price > 100)continue;
-
-        flag = true;
-        path_list = list[2].split("分钟", Qt::SkipEmptyParts);
-        if(path_list.size() != 1)continue;
-        qreal time = path_list[0].toDouble(&flag);
-        if(!flag || time < 0 || time > 100)continue;
-
-        flag = true;
-        path_list = list[3].split("/分钟", Qt::SkipEmptyParts);
-        qreal speed = path_list[0].toDouble(&flag);
-        if(!flag || speed < 0 || speed > 100)continue;
-
-        QVector<QPair<QString, QPointF> > pathnodes;
-        list = list[0].split("；", Qt::SkipEmptyParts);
-        for(QString s : list){
-            QStringList node_list = s.split("(", Qt::SkipEmptyParts);
-            if(node_list.size() != 2)continue;
-            QString node_name = node_list[0];
-            node_list = node_list[1].split(")", Qt::SkipEmptyParts);
-            if(node_list.size() != 1)continue;
-            node_list = node_list[0].split(",", Qt::SkipEmptyParts);
-            if(node_list.size() != 2)continue;
-            flag = true;
-            qreal node_x = node_list[0].toDouble(&flag);
-            if(!flag || node_x < INT_MIN / 2 || node_x > INT_MAX / 2)continue;
-            flag = true;
-            qreal node_y = node_list[1].toDouble(&flag);
-            if(!flag || node_y < INT_MIN / 2 || node_y > INT_MAX / 2)continue;
-            pathnodes.push_back(QPair<QString, QPointF> (node_name, posToPix(QPointF(node_x, node_y))));
-        }
-        if(pathnodes.empty()){
+        if(i < stop_count){
+            nodes[i] = new Node(snapshot.getStopPos(i));
+            nodes[i]->setName(snapshot.getStopName(i));
+            nodes[i]->setIs_highlight(true);
             continue;
         }
+        int line = i - stop_count;
         Path *path = new Path();
-        path->setName(name);
-        path->setPrice(price);
-        path->setTime(time);
-        path->setSpeed(speed);
+        path->setName(snapshot.getLineName(line));
+        path->setPrice(snapshot.getLinePrice(line));
+        path->setTime(snapshot.getLineTime(line));
+        path->setSpeed(snapshot.getLineSpeed(line));
+        const qint32 *stops = snapshot.getLineStops(line);
         Node *last_node = nullptr;
-        for(QPair<QString, QPointF> p : pathnodes){
-            Node *node = nullptr;
-            QPair<qreal, qreal> pos(p.second.x(), p.second.y());
-            if(map.contains(pos))node = map[pos];
-            else map[pos] = node = new Node(p.second);
-            node->setName(p.first);
-            node->setIs_highlight(true);
+        for(int k = 0, size = snapshot.getLineStopCount(line); k < size; k++){
+            Node *node = nodes[stops[k]];
             Edge *edge = nullptr;
             if(node == last_node)continue;
             if(last_node != nullptr){
@@ -838,17 +1023,48 @@ void GraphView::openFile(const QString &file_path)
             }
             path->getPathnodes()->push_back(new PathNode(path, node, edge));
             last_node = node;
-//            path->addNode(p.second, p.first);
         }
     }
-//    printf("path size: %d\n",Path::paths.size());
-//    printf("node size: %d\n",Node::nodes.size());
-//    printf("edge size: %d\n",Edge::edges.size());
-//    fflush(stdout);
-    file.close();
-    clearHighlight();
-    setViewAll();
-    viewport()->update();
+    return true;
+}
+
+// Only a model whose ids have no gaps, as a fresh open leaves it, is
+// written, so that the ids of the snapshot are the ids of the model.
+void GraphView::saveSnapshot()
+{
+    QVector<QPointF> stop_pos;
+    QVector<QString> stop_names;
+    for(Node *node : Node::id_nodes){
+        if(node == nullptr)return;
+        stop_pos.push_back(node->pos());
+        stop_names.push_back(node->getName());
+    }
+    QVector<RouteSnapshot::Line> lines;
+    for(Path *path : Path::id_paths){
+        if(path == nullptr)return;
+        RouteSnapshot::Line line;
+        line.name = path->getName();
+        line.price = path->getPrice();
+        line.time = path->getTime();
+        line.speed = path->getSpeed();
+        for(PathNode *pathnode : *path->getPathnodes()){
+            line.stops.push_back(pathnode->node->getId());
+        }
+        lines.push_back(line);
+    }
+    RouteSnapshot::write(file_path, stop_pos, stop_names, lines);
+}
+
+void GraphView::preprocess()
+{
+    QProgressDialog dialog("预处理进度", QString(), 1, 3, this);
+    dialog.show();
+    for(int opt = 1; opt < 3; opt++){
+        dialog.setValue(opt);
+        QCoreApplication::processEvents();
+        GraphAlgorithm::getHierarchy(opt);
+    }
+    dialog.setValue(3);
 }
 
 void GraphView::saveFile(const QString &file_path)
@@ -907,6 +1123,13 @@ void GraphView::saveFile(const QString &file_path)
     file.close();
 }
 
+// The query file is answered QUERY_BLOCK lines at a time and the answers go
+// out through one buffered writer, so memory stays the same however long
+// the file is. Once cancelled, the remaining lines of a text answer are still
+// copied but not answered. The machine formats write one record per query
+// line that is not blank, built from the vertex paths without any prose; a
+// cancelled block would leave unanswered queries looking unreachable, so
+// they stop before it.
 void GraphView::queryFile(const QString &file_path)
 {
     QFile rfile(file_path);
@@ -914,102 +1137,217 @@ void GraphView::queryFile(const QString &file_path)
         QMessageBox::critical(this, "错误", "读入文件错误");
         return;
     }
-    QString save_path = file_path;
-    QFile wfile(save_path.replace(".txt", "_routes_output.txt"));
-    if(!wfile.open(QIODevice::WriteOnly | QIODevice::Text)){
+    RouteFile::Format format = output_format;
+    QFile wfile(RouteFile::outputPath(file_path, format));
+    if(!wfile.open(format == RouteFile::Binary ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text)){
         QMessageBox::critical(this, "错误", "写入文件错误");
         return;
     }
-    QStringList lines;
-    while(!rfile.atEnd()){
-        lines.push_back(rfile.readLine().trimmed());
-    }
-    QProgressDialog dialog("路径计算进度", "取消", 0, lines.size(), this);
+    // Finished text lines are cached by strategy, endpoints and the revision
+    // of the strategy while the network version stays; repeated queries of
+    // this file and of earlier files skip both the search and the formatting.
+    RouteNetwork *net = GraphAlgorithm::getNetwork();
+    if(route_cache_version != net->getVersion()){
+        route_cache.clear();
+        route_cache_version = net->getVersion();
+    }
+    qint64 file_size = qMax(rfile.size(), qint64(1));
+    QProgressDialog dialog("路径计算进度", "取消", 0, 1000, this);
+    // the workers read the compiled network, so the model must not change
+    dialog.setWindowModality(Qt::WindowModal);
     dialog.show();
-    for(int i = 0, size = lines.size(); i < size; i++){
-        dialog.setValue(i);
-        QCoreApplication::processEvents();
-        if(dialog.wasCanceled()){
-            break;
+    GraphAlgorithm model(GraphAlgorithm::getPreprocess() ? GraphAlgorithm::Hierarchy : GraphAlgorithm::AStar);
+    RouteFile::Writer writer(&wfile);
+    writer.writeHeader(format);
+    std::function<QByteArray(int)> stop_name = [](int stop){
+        return Node::id_nodes[stop]->getName().toUtf8();
+    };
+    std::function<QByteArray(int)> line_name = [](int line){
+        return Path::id_paths[line]->getName().toUtf8();
+    };
+    RouteFile::Answer answer;
+    qint64 index = 0;
+    bool finished = true;
+    int ambiguous = 0;
+    int hits = 0;
+    int misses = 0;
+    QVector<QByteArray> lines;
+    QVector<int> opts;
+    QVector<Node *> start_nodes;
+    QVector<Node *> end_nodes;
+    QVector<QByteArray> start_names;
+    QVector<QByteArray> end_names;
+    QVector<QByteArray> results;
+    QVector<int> miss_of;
+    qint64 block_begin = 0;
+    while((finished || format == RouteFile::Text) && RouteFile::readLines(&rfile, QUERY_BLOCK, &lines) > 0){
+        qint64 block_end = rfile.pos();
+        int size = lines.size();
+        opts.fill(-1, size);
+        start_nodes.fill(nullptr, size);
+        end_nodes.fill(nullptr, size);
+        start_names.fill(QByteArray(), size);
+        end_names.fill(QByteArray(), size);
+        results.fill(QByteArray(), size);
+        miss_of.fill(-1, size);
+        for(int i = 0; i < size && finished; i++){
+            RouteFile::Query query;
+            if(!RouteFile::parseQuery(QString::fromUtf8(lines[i]), &query))continue;
+            start_names[i] = query.start.toUtf8();
+            end_names[i] = query.end.toUtf8();
+            QList<Node *> starts = Node::findName(query.start);
+            QList<Node *> ends = Node::findName(query.end);
+            if(starts.size() > 1 || ends.size() > 1){
+                ambiguous++;
+            }
+            if(!starts.empty()){
+                start_nodes[i] = starts.front();
+            }
+            if(!ends.empty()){
+                end_nodes[i] = ends.front();
+            }
+            opts[i] = query.opt;
         }
-        QString str = lines[i];
-        wfile.write((str + '\n').toStdString().c_str());
-        QStringList list = str.split(" ", Qt::SkipEmptyParts);
-        bool flag = false;
-        int opt = list[0].toInt(&flag);
-        if(!flag)continue;
-        Node *start_node = nullptr;
-        Node *end_node = nullptr;
-        foreach(Node *node, Node::nodes){
-            if(node->getName() == list[1]){
-                start_node = node;
+        QVector<std::tuple<int, int, int, unsigned long long> > keys;
+        QVector<int> miss_lines;
+        QMap<std::tuple<int, int, int, unsigned long long>, int> miss_index;
+        for(int i = 0; i < size; i++){
+            if(opts[i] < 0 || opts[i] > 2 || start_nodes[i] == nullptr || end_nodes[i] == nullptr)continue;
+            std::tuple<int, int, int, unsigned long long> key(opts[i], start_nodes[i]->getId(), end_nodes[i]->getId(), net->getRevision(opts[i]));
+            if(format == RouteFile::Text && route_cache.find(key, &results[i])){
+                hits++;
+                continue;
             }
-            if(node->getName() == list[2]){
-                end_node = node;
+            misses++;
+            if(!miss_index.contains(key)){
+                miss_index[key] = miss_lines.size();
+                miss_lines.push_back(i);
+                keys.push_back(key);
             }
+            miss_of[i] = miss_index[key];
         }
-        GraphAlgorithm model;
-        QVector<QVector<QPair<Node *, Path *> > *> ans_routes = model.solve(start_node, end_node, opt, 1);
-        if(ans_routes.empty())continue;
-        str = "";
-//        qreal totDis = 0;
-        qreal totTime = 0;
-        qreal totPrice = 0;
-//        int totChange = 0;
-        Path *last_path = nullptr;
-        Node *last_node = nullptr;
-        bool first_path = true;
-        bool first_node = true;
-        for(QPair<Node *, Path *> p : *ans_routes[0]){
-            Node *node = p.first;
-            Path *path = p.second;
-            if(node != nullptr && path != nullptr){
-                if(path != last_path){
-//                    totChange++;
-                    totPrice += path->getPrice();
-                    if(opt != 1){
-                        totTime += path->getTime();
-                    }
-                    if(!first_path){
-                        str += "；";
-                    }
-                    first_path = false;
-                    first_node = true;
-                    str += "换乘" + path->getName() + "：";
+        QVector<int> miss_opts;
+        QVector<Node *> miss_starts;
+        QVector<Node *> miss_ends;
+        for(int i : miss_lines){
+            miss_opts.push_back(opts[i]);
+            miss_starts.push_back(start_nodes[i]);
+            miss_ends.push_back(end_nodes[i]);
+        }
+        int miss_count = qMax(int(miss_lines.size()), 1);
+        std::function<bool(int)> progress = [&dialog, block_begin, block_end, file_size, miss_count](int done){
+            qint64 bytes = block_begin + (block_end - block_begin) * done / miss_count;
+            dialog.setValue(int(qMin(bytes, file_size) * 1000 / file_size));
+            QCoreApplication::processEvents();
+            return !dialog.wasCanceled();
+        };
+        if(format != RouteFile::Text){
+            std::vector<std::vector<int> > miss_paths(miss_lines.size());
+            if(!miss_lines.empty()){
+                miss_paths = model.solvePaths(miss_opts, miss_starts, miss_ends, progress, &finished);
+            }
+            if(!finished)break;
+            for(int i = 0; i < size; i++){
+                index++;
+                if(lines[i].isEmpty())continue;
+                answer.index = index;
+                answer.opt = opts[i];
+                answer.start = start_names[i];
+                answer.end = end_names[i];
+                answer.S = start_nodes[i] == nullptr ? -1 : start_nodes[i]->getId();
+                answer.T = end_nodes[i] == nullptr ? -1 : end_nodes[i]->getId();
+                RouteFile::answer(net, miss_of[i] >= 0 ? miss_paths[miss_of[i]] : std::vector<int>(), &answer);
+                writer.writeAnswer(format, answer, stop_name, line_name);
+            }
+        }
+        else{
+            QVector<QVector<QPair<Node *, Path *> > *> ans_routes(miss_lines.size(), nullptr);
+            if(!miss_lines.empty()){
+                ans_routes = model.solveBatch(miss_opts, miss_starts, miss_ends, progress, &finished);
+            }
+            QVector<QByteArray> miss_results(miss_lines.size());
+            for(int k = 0, count = miss_lines.size(); k < count; k++){
+                if(ans_routes[k] != nullptr){
+                    miss_results[k] = routeString(ans_routes[k], miss_opts[k]).toUtf8();
                 }
-                if(last_node != nullptr && node != last_node){
-                    qreal dis = Node::Distance(last_node, node);
-//                    totDis += dis;
-                    totTime += dis / path->getSpeed();
+                if(finished){
+                    route_cache.insert(keys[k], miss_results[k]);
                 }
-                if(!first_node){
-                    str += "，";
+            }
+            qDeleteAll(ans_routes);
+            for(int i = 0; i < size; i++){
+                if(miss_of[i] >= 0){
+                    results[i] = miss_results[miss_of[i]];
+                }
+                lines[i].append('\n');
+                writer.write(lines[i]);
+                if(!results[i].isEmpty()){
+                    writer.write(results[i]);
                 }
-                first_node = false;
-                str += node->getName();
             }
-            last_node = node;
-            last_path = path;
-        }
-        if(opt == 0){
-            str += "。共花费" + QString::number(totPrice) + "元。\n";
-        }
-        else if(opt == 1){
-            str += "。共花费" + QString::number(totTime) + "时间。\n";
-
         }
-        else if(opt == 2){
-            str += "。共花费" + QString::number(totTime) + "时间。\n";
+        block_begin = block_end;
+        if(finished){
+            dialog.setValue(int(qMin(block_end, file_size) * 1000 / file_size));
+            QCoreApplication::processEvents();
+            finished = !dialog.wasCanceled();
         }
-        wfile.write(str.toStdString().c_str());
     }
+    bool written = writer.flush();
     rfile.close();
     wfile.close();
+    if(!written){
+        QMessageBox::critical(this, "错误", "写入文件错误");
+        return;
+    }
+    QString message = QString(finished ? "批量查询完成" : "批量查询已取消");
+    // only text answers go through the route cache
+    if(format == RouteFile::Text){
+        message += QString("，缓存命中%1次，未命中%2次").arg(hits).arg(misses);
+    }
+    else if(!finished){
+        message += QString("，结果只包含前%1行查询").arg(index);
+    }
+    if(ambiguous > 0){
+        message += QString("；%1条查询的站名对应多个站点，已使用编号最小的站点").arg(ambiguous);
+    }
+    QMessageBox::information(this, "提示", message);
+}
+
+QString GraphView::routeString(QVector<QPair<Node *, Path *> > *route, int opt)
+{
+    QVector<RouteFile::Hop> hops;
+    for(QPair<Node *, Path *> p : *route){
+        Node *node = p.first;
+        Path *path = p.second;
+        if(node == nullptr)continue;
+        RouteFile::Hop hop;
+        hop.stop = node->getId();
+        hop.stop_name = node->getName();
+        hop.pos = node->pos();
+        hop.line = path == nullptr ? -1 : path->getId();
+        hop.line_name = path == nullptr ? QString() : path->getName();
+        hop.price = path == nullptr ? 0 : path->getPrice();
+        hop.time = path == nullptr ? 0 : path->getTime();
+        hop.speed = path == nullptr ? 0 : path->getSpeed();
+        hops.push_back(hop);
+    }
+    return RouteFile::routeString(hops, opt, GraphAlgorithm::getWalkSpeed());
 }
 
 void GraphView::setEnableScene(bool flag)
 {
     if(flag){
+        // Nodes and edges made while the scene was detached were never added
+        // to it.
+        if(!enable_scene){
+            foreach(Node *node, Node::nodes){
+                if(node->scene() != &scene)scene.addItem(node);
+            }
+            foreach(Edge *edge, Edge::edges){
+                if(edge->scene() != &scene)scene.addItem(edge);
+            }
+        }
         enable_scene = true;
         this->setEnabled(true);
         setScene(&scene);
@@ -1050,6 +1388,18 @@ qreal GraphView::getView_scale() const
     return view_scale;
 }
 
+int GraphView::getRoute_size() const
+{
+    return route_size;
+}
+
+// With a single route a query is answered by the contraction hierarchy when
+// preprocessing is on, instead of ranking alternatives.
+void GraphView::setRoute_size(int newRoute_size)
+{
+    route_size = qMax(newRoute_size, 1);
+}
+
 void GraphView::setOffset(const QPointF &pos)
 {
     offset = pos;
@@ -1196,6 +1546,7 @@ void GraphView::deletePath(Path *path)
     if(Path::paths.contains(path)){
         clearHighlight();
         delete path;
+        GraphAlgorithm::invalidate();
         viewport()->update();
         showStartEndNode();
     }
@@ -1230,10 +1581,14 @@ void GraphView::queryRoute()
 {
     setMode(Select);
     if(!Node::nodes.contains(start_node) || !Node::nodes.contains(end_node) || start_node == end_node)return;
-    GraphAlgorithm model;
+    GraphAlgorithm model(GraphAlgorithm::getRoundBased() ? GraphAlgorithm::Raptor
+                         : GraphAlgorithm::getPreprocess() ? GraphAlgorithm::Hierarchy : GraphAlgorithm::AStar);
     int strategy_id = GlobalVar::stategy_box->currentIndex();
     QVector<QVector<QPair<Node *, Path *> > *> ans_routes
-            = model.solve(start_node, end_node, GlobalVar::stategy_box->currentIndex(), 5);
+            = model.solve(start_node, end_node, GlobalVar::stategy_box->currentIndex(), route_size);
+    RouteTreeCache *trees = GraphAlgorithm::getTreeCache();
+    emit statusChanged(QString("最短路径树缓存命中%1次，未命中%2次，淘汰%3次")
+                       .arg(trees->getHits()).arg(trees->getMisses()).arg(trees->getEvictions()));
     int route_count = 0;
     GlobalVar::output_list->clear();
     for(QVector<QPair<Node *, Path *> > *route : ans_routes){
@@ -1260,6 +1615,11 @@ void GraphView::queryRoute()
                     totTime += dis / path->getSpeed();
                 }
             }
+            else if(node != nullptr && last_node != nullptr && node != last_node){
+                qreal dis = Node::Distance(last_node, node);
+                totDis += dis;
+                totTime += dis / GraphAlgorithm::getWalkSpeed();
+            }
             last_node = node;
             last_path = path;
         }
@@ -1273,11 +1633,35 @@ void GraphView::queryRoute()
                             .append("次)"));
         GlobalVar::output_list->addTopLevelItem(route_item);
         last_path = nullptr;
+        last_node = nullptr;
         OutputItem *last_path_item = nullptr;
         for(QPair<Node *, Path *> p : *route){
             Node *node = p.first;
             Path *path = p.second;
-            if(node == nullptr || path == nullptr)continue;
+            if(node == nullptr)continue;
+            if(path == nullptr){
+                // Walking legs in a row share one item, which starts at
+                // the stop walked from.
+                if(last_node != nullptr && node != last_node){
+                    if(last_path_item == nullptr || last_path != nullptr){
+                        last_path = nullptr;
+                        last_path_item = new OutputItem();
+                        last_path_item->setText(0, "步行");
+                        route_item->addChild(last_path_item);
+                        OutputItem *node_item = new OutputItem();
+                        node_item->node = last_node;
+                        node_item->setText(0, last_node->getName());
+                        last_path_item->addChild(node_item);
+                    }
+                    OutputItem *node_item = new OutputItem();
+                    node_item->node = node;
+                    node_item->setText(0, node->getName());
+                    last_path_item->addChild(node_item);
+                }
+                last_node = node;
+                continue;
+            }
+            last_node = node;
             if(path != last_path){
                 last_path = path;
                 last_path_item = new OutputItem();
@@ -1333,6 +1717,23 @@ bool GraphView::getHave_file_path() const
     return have_file_path;
 }
 
+// Cached answer lines spell out stop and line names, which are not part of
+// the compiled network, so a rename drops them.
+void GraphView::clearRouteCache()
+{
+    route_cache.clear();
+}
+
+RouteFile::Format GraphView::getOutput_format() const
+{
+    return output_format;
+}
+
+void GraphView::setOutput_format(RouteFile::Format newOutput_format)
+{
+    output_format = newOutput_format;
+}
+
 
 void GraphView::showListItem(QListWidgetItem *item)
 {
@@ -1346,9 +1747,7 @@ void GraphView::showListItem(QListWidgetItem *item)
 
 void GraphView::nodeFilter(const QString &str)
 {
-    foreach(Node *node, Node::nodes) {
-        node->setHidden(!node->text().contains(str));
-    }
+    Node::filter(str);
 }
 
 void GraphView::showTreeItem(QTreeWidgetItem *item)
@@ -1420,7 +1819,7 @@ void GraphView::mousePressEvent(QMouseEvent *event)
         QPoint pos = event->pos();
         QPointF scene_pos = this->mapToScene(pos);
         if(mode == Select){
-            Node *node = dynamic_cast<Node *>(scene.itemAt(scene_pos, QTransform()));
+            Node *node = Node::findAt(scene_pos);
             if(node != nullptr){
                 setHighlightNode(node);
                 node->showProperty();
@@ -1490,169 +1889,255 @@ void GraphView::wheelEvent(QWheelEvent *event)
 /*** main view end ***/
 
 /*** algorithm start ***/
-GraphAlgorithm::GraphAlgorithm()
-    : tot_node(0),
-      map(),
-      id_node(),
-      id_path(),
-      g(),
-      g_r(),
-      dis(),
-      tr(),
-      g2(),
-      vis()
+unsigned long long GraphAlgorithm::version = 1;
+RouteNetwork GraphAlgorithm::network = RouteNetwork();
+RouteHierarchy GraphAlgorithm::hierarchy[3];
+bool GraphAlgorithm::enable_preprocess = false;
+bool GraphAlgorithm::enable_rounds = false;
+qreal GraphAlgorithm::walk_radius = 0;
+qreal GraphAlgorithm::walk_speed = 0;
+RouteTreeCache GraphAlgorithm::trees;
+
+GraphAlgorithm::GraphAlgorithm(Engine engine)
+    : engine(engine),
+      net(nullptr),
+      search(),
+      raptor()
 {
 
 }
 
-QVector<QVector<QPair<Node *, Path *> > *> GraphAlgorithm::solve(Node *start_node, Node *end_node, int opt, int size)
+void GraphAlgorithm::invalidate()
 {
-    QVector<QVector<QPair<Node *, Path *> > *> ans_routes;
-    int cnt = Node::nodes.size();
-    foreach(Path *path, Path::paths){
-        cnt += 4 * path->getPathnodes()->size();
-    }
-    setup(cnt);
-    cnt = 0;
-    foreach(Node *node, Node::nodes){
-        map[node] = cnt;
-        cnt++;
+    version++;
+}
+
+// A compiled network that is still current gets the new price, time and
+// speed of the path patched in place; one that is already stale picks them
+// up when it is rebuilt.
+void GraphAlgorithm::updatePath(Path *path)
+{
+    if(network.getVersion() != version)return;
+    network.setLine(path->getId(), path->getPrice(), path->getTime(), path->getSpeed());
+}
+
+RouteNetwork *GraphAlgorithm::getNetwork()
+{
+    if(network.getVersion() == version)return &network;
+    network.clear();
+    network.setWalk(walk_radius, walk_speed);
+    for(Node *node : Node::id_nodes){
+        if(node != nullptr)network.addStop(node->x(), node->y());
+        else network.addStop(0, 0);
     }
-    if(!map.count(start_node) || !map.count(end_node))return ans_routes;
-    foreach(Path *path, Path::paths){
-        QVector<PathNode *> *pathnodes = path->getPathnodes();
-        Node *last_node = nullptr;
-        for(QVector<PathNode *>::iterator it = pathnodes->begin(); it != pathnodes->end(); it++){
-            Node *node = (*it)->node;
-            if(it != pathnodes->begin()){
-                if(opt == 0 || opt == 2){
-                    g[cnt + 2].push_back(std::pair<int, double>(cnt, 0));
-                    g[cnt + 1].push_back(std::pair<int, double>(cnt + 3, 0));
-                }
-                double w = 0;
-                if(opt == 1 || opt == 2)w = Node::Distance(last_node, node) / path->getSpeed();
-                g[cnt].push_back(std::pair<int, double>(cnt - 2, w));
-                g[cnt - 1].push_back(std::pair<int, double>(cnt + 1, w));
+    for(Path *path : Path::id_paths){
+        std::vector<int> stops;
+        if(path != nullptr){
+            for(PathNode *pathnode : *path->getPathnodes()){
+                stops.push_back(pathnode->node->getId());
             }
-            id_node[cnt] = id_node[cnt + 1] = id_node[cnt + 2] = id_node[cnt + 3] = node;
-            id_path[cnt] = id_path[cnt + 1] = id_path[cnt + 2] = id_path[cnt + 3] = path;
-            if(map.count(node)){
-                int v = map[node];
-                g[cnt + 1].push_back(std::pair<int, double>(v, 0));
-                g[cnt + 2].push_back(std::pair<int, double>(v, 0));
-                double w = 0;
-                if(opt == 0)w = path->getPrice();
-                else if(opt == 1)w = 0;
-                else if(opt == 2)w = path->getTime();
-                g[v].push_back(std::pair<int, double>(cnt, w));
-                g[v].push_back(std::pair<int, double>(cnt + 3, w));
-            }
-            last_node = node;
-            cnt += 4;
+            network.addLine(path->getPrice(), path->getTime(), path->getSpeed(), stops);
+        }
+        else{
+            network.addLine(0, 0, 0, stops);
         }
     }
-    dijkstra(map[start_node]);
-//    printf("disT = %lf\n",dis[map[end_node]]);
-//    fflush(stdout);
-    findPaths(map[start_node], map[end_node], size, &ans_routes);
-    return ans_routes;
+    network.setVersion(version);
+    return &network;
 }
 
-void GraphAlgorithm::setup(int tot_node)
+RouteHierarchy *GraphAlgorithm::getHierarchy(int opt)
 {
-    this->tot_node = tot_node;
-    map.clear();
-    id_node = std::vector<Node *> (tot_node, nullptr);
-    id_path = std::vector<Path *> (tot_node, nullptr);
-    g = std::vector<std::vector<std::pair<int, double> > > (tot_node);
-    g_r = std::vector<std::vector<int> > (tot_node);
-    dis = std::vector<double> (tot_node, 1e18);
-    tr.clear();
-}
-
-void GraphAlgorithm::dijkstra(int S)
-{
-    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > q;
-    dis[S] = 0;
-    q.push(std::make_pair(0, S));
-    while(!q.empty()){
-        std::pair<double, int> p = q.top();
-        q.pop();
-        double d = p.first;
-        int u=p.second;
-        if(std::fabs(d - dis[u]) > 1e-6){
-            continue;
-        }
-        for(std::pair<int, double> e : g[u]){
-            int v = e.first;
-            double w = e.second;
-            if(dis[v] > dis[u] + w){
-                dis[v] = dis[u] + w;
-                q.push(std::make_pair(dis[v], v));
-            }
-        }
+    RouteNetwork *net = getNetwork();
+    if(!hierarchy[opt].isBuilt() || hierarchy[opt].getVersion() != net->getVersion()
+            || hierarchy[opt].getRevision() != net->getRevision(opt)){
+        hierarchy[opt].build(net, opt);
     }
+    return &hierarchy[opt];
 }
 
-void GraphAlgorithm::dijkstra_base(int S)
+bool GraphAlgorithm::getPreprocess()
 {
-    dis[S] = 0;
-    for(int i = 0; i < tot_node; i++){
-        int t = -1;
-        for(int j = 0; j < tot_node; j++){
-            if(!vis[j] && (t==-1 || dis[t] > dis[j])){
-                t = j;
-            }
-        }
-        vis[t] = true;
-        for(int j = 0; j < tot_node; j++){
-            dis[j] = fmin(dis[j], dis[t] + g2[t][j]);
+    return enable_preprocess;
+}
+
+void GraphAlgorithm::setPreprocess(bool flag)
+{
+    enable_preprocess = flag;
+    if(!flag){
+        for(int opt = 0; opt < 3; opt++){
+            hierarchy[opt].clear();
         }
     }
 }
 
-void GraphAlgorithm::findPaths(int S, int T, int size, QVector<QVector<QPair<Node *, Path *> > *> *ans)
+bool GraphAlgorithm::getRoundBased()
 {
-    for(int u = 0; u < tot_node; u++){
-        for(std::pair<int, double> p : g[u]){
-            int v = p.first;
-            double w = p.second;
-            if(fabs(dis[v] - dis[u] - w) < 1e-6){
-                g_r[v].push_back(u);
-            }
+    return enable_rounds;
+}
+
+void GraphAlgorithm::setRoundBased(bool flag)
+{
+    enable_rounds = flag;
+}
+
+qreal GraphAlgorithm::getWalkRadius()
+{
+    return walk_radius;
+}
+
+qreal GraphAlgorithm::getWalkSpeed()
+{
+    return walk_speed;
+}
+
+// Footpaths change the edges of every strategy, so the network is rebuilt.
+void GraphAlgorithm::setWalk(qreal radius, qreal speed)
+{
+    if(radius <= 0 || speed <= 0)radius = speed = 0;
+    if(walk_radius == radius && walk_speed == speed)return;
+    walk_radius = radius;
+    walk_speed = speed;
+    invalidate();
+}
+
+RouteTreeCache *GraphAlgorithm::getTreeCache()
+{
+    return &trees;
+}
+
+GraphAlgorithm::Engine GraphAlgorithm::getEngine() const
+{
+    return engine;
+}
+
+void GraphAlgorithm::setEngine(Engine newEngine)
+{
+    engine = newEngine;
+}
+
+QVector<QVector<QPair<Node *, Path *> > *> GraphAlgorithm::solve(Node *start_node, Node *end_node, int opt, int size)
+{
+    QVector<QVector<QPair<Node *, Path *> > *> ans_routes;
+    if(opt < 0 || opt > 3)return ans_routes;
+    if(!Node::nodes.contains(start_node) || !Node::nodes.contains(end_node))return ans_routes;
+    net = getNetwork();
+    int S = start_node->getId();
+    int T = end_node->getId();
+    std::vector<std::vector<int> > paths;
+    // Strategy 3 compares price, time and transfers, returning every route
+    // that is not beaten on all three regardless of size.
+    if(opt == 3){
+        search.setNetwork(net, 2);
+        search.pareto(S, T, &paths);
+        for(const std::vector<int> &path : paths){
+            ans_routes.push_back(decode(path));
+        }
+        return ans_routes;
+    }
+    // The round based engine lists the cheapest route for every number of
+    // boardings that improves on fewer, straight from the line stop lists.
+    if(engine == Raptor){
+        raptor.setNetwork(net, opt);
+        std::vector<std::vector<std::pair<int, int> > > routes;
+        raptor.query(S, T, &routes);
+        for(const std::vector<std::pair<int, int> > &route : routes){
+            ans_routes.push_back(decode(route));
         }
+        return ans_routes;
+    }
+    search.setNetwork(net, opt);
+    // Riding is free under the price strategy, so its hierarchy degenerates
+    // into near cliques per line while the bidirectional search meets after
+    // a few boardings; price queries keep using the latter.
+    if(engine == Hierarchy && size == 1){
+        std::vector<int> path;
+        if(opt != 0)search.hierarchy(*getHierarchy(opt), S, T, &path);
+        else search.bidirectional(S, T, &path);
+        if(!path.empty())paths.push_back(path);
+    }
+    else if(size > 1){
+        // Exact distances into T from the tree of an end kept from the last
+        // query steer every spur search of kShortest straight to T; a new
+        // end leaves them to the A* bounds.
+        const RouteTreeCache::Tree *tree = trees.target(net, search, opt, T);
+        search.setPotential(tree == nullptr ? nullptr : &tree->dist);
+        search.kShortest(S, T, size, &paths);
+        search.setPotential(nullptr);
     }
-    std::queue<int> q;
-    q.push(T);
-    tr.push_back(std::pair<int, int>(T, -1));
-    int now = 0;
-    while(!q.empty()){
-        int u = q.front();
-        q.pop();
-        if(u == S){
-            QVector<QPair<Node*, Path *> > *res = new QVector<QPair<Node*, Path *> >();
-            for(int tmp = now; tmp >= 0; tmp = tr[tmp].second){
-                int id = tr[tmp].first;
-//                printf("id = %d\n",id);
-//                fflush(stdout);
-                if(id_node[id] != nullptr && id_path[id] != nullptr){
-                    QPair<Node *, Path *> p(id_node[id], id_path[id]);
-                    if(res->empty() || p != res->back()){
-                        res->push_back(p);
-                    }
-                }
-            }
-            ans->push_back(res);
+    else{
+        // A start or end kept from the last query is answered from its tree
+        // by walking parents, any other query by A*.
+        std::vector<int> path;
+        if(!trees.route(net, search, opt, S, T, &path)){
+            search.astar(S, T);
+            search.findPath(T, &path);
         }
-        else{
-            for(int v : g_r[u]){
-                if(int(q.size()) < size){
-                    q.push(v);
-                    tr.push_back(std::pair<int, int>(v, now));
-                }
-            }
+        paths.push_back(path);
+    }
+    for(const std::vector<int> &path : paths){
+        if(!path.empty())ans_routes.push_back(decode(path));
+    }
+    return ans_routes;
+}
+
+// Answers query i from start_nodes[i] to end_nodes[i] under opts[i] on all
+// cores. The entries of a query that cannot be answered are nullptr.
+QVector<QVector<QPair<Node *, Path *> > *> GraphAlgorithm::solveBatch(const QVector<int> &opts, const QVector<Node *> &start_nodes, const QVector<Node *> &end_nodes,
+                                                                      const std::function<bool(int)> &progress, bool *finished)
+{
+    QVector<QVector<QPair<Node *, Path *> > *> ans_routes(opts.size(), nullptr);
+    std::vector<std::vector<int> > paths = solvePaths(opts, start_nodes, end_nodes, progress, finished);
+    for(int i = 0, size = opts.size(); i < size; i++){
+        if(!paths[i].empty())ans_routes[i] = decode(paths[i]);
+    }
+    return ans_routes;
+}
+
+// As solveBatch, but leaves the routes as vertex paths of the compiled
+// network, empty when a query cannot be answered.
+std::vector<std::vector<int> > GraphAlgorithm::solvePaths(const QVector<int> &opts, const QVector<Node *> &start_nodes, const QVector<Node *> &end_nodes,
+                                                          const std::function<bool(int)> &progress, bool *finished)
+{
+    net = getNetwork();
+    RouteBatch batch;
+    batch.setNetwork(net);
+    if(engine == Hierarchy){
+        batch.setHierarchy(1, getHierarchy(1));
+        batch.setHierarchy(2, getHierarchy(2));
+    }
+    std::vector<RouteBatch::Query> queries(opts.size());
+    for(int i = 0, size = opts.size(); i < size; i++){
+        RouteBatch::Query &query = queries[i];
+        query.opt = opts[i];
+        query.S = Node::nodes.contains(start_nodes[i]) ? start_nodes[i]->getId() : -1;
+        query.T = Node::nodes.contains(end_nodes[i]) ? end_nodes[i]->getId() : -1;
+    }
+    std::vector<std::vector<int> > paths;
+    bool flag = batch.run(queries, &paths, progress);
+    if(finished != nullptr)*finished = flag;
+    return paths;
+}
+
+QVector<QPair<Node *, Path *> > *GraphAlgorithm::decode(const std::vector<int> &path)
+{
+    std::vector<std::pair<int, int> > route;
+    net->itinerary(path, &route);
+    return decode(route);
+}
+
+// (stop, line) pairs to nodes and paths, with nullptr for the path of a
+// stop reached on foot.
+QVector<QPair<Node *, Path *> > *GraphAlgorithm::decode(const std::vector<std::pair<int, int> > &route)
+{
+    QVector<QPair<Node*, Path *> > *res = new QVector<QPair<Node*, Path *> >();
+    for(const std::pair<int, int> &p : route){
+        Node *node = Node::id_nodes[p.first];
+        QPair<Node *, Path *> pair(node, p.second < 0 ? nullptr : Path::id_paths[p.second]);
+        if(node != nullptr && (res->empty() || pair != res->back())){
+            res->push_back(pair);
         }
-        now++;
     }
+    return res;
 }
 /*** algorithm end ***/
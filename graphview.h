@@ -11,9 +11,20 @@
 #include <QTreeWidget>
 #include <QLabel>
 #include <set>
+#include <tuple>
 #include <QComboBox>
 #include <QStatusBar>
 #include <QProgressBar>
+#include <QMultiMap>
+#include "routenetwork.h"
+#include "routesearch.h"
+#include "routehierarchy.h"
+#include "routebatch.h"
+#include "routeraptor.h"
+#include "routecache.h"
+#include "routegrid.h"
+#include "routefile.h"
+#include "routesnapshot.h"
 
 
 /*** ui item functions rewrite start ***/
@@ -48,12 +59,14 @@ public:
     PropertySpinBox(QWidget *parent = nullptr);
     void clear();
     void setPropertyValue(qreal *newPropertyValue);
+    void setPath(Path *path);
 
 protected:
     void focusOutEvent(QFocusEvent *event);
 
 private:
     qreal *property_value;
+    Path *path;
 };
 
 
@@ -108,6 +121,7 @@ class PathNode;
 class Node : public QGraphicsItem, public QListWidgetItem{
 public:
     static QSet<Node *> nodes;
+    static QVector<Node *> id_nodes;
     Node(const QPointF &pos = QPointF(0.0, 0.0));
     ~Node();
     static void resetup();
@@ -119,14 +133,30 @@ public:
     void insertPath(PathNode *pathnode);
     void deletePath(PathNode *pathnode);
     int getPathCount() const;
+    int getId() const;
     QString getName() const;
     QString *getNamePointer();
     void setName(const QString &newName);
     void setIs_highlight(bool newIs_highlight);
     std::multiset<PathNode *> *getPaths();
+    static QList<Node *> findName(const QString &name);
+    static QList<Node *> findPrefix(const QString &prefix);
+    static QStringList getDuplicateNames();
+    static void filter(const QString &prefix);
+    static Node *findNearest(const QPointF &pos, qreal limit = 1e18);
+    static Node *findAt(const QPointF &pos);
+    qreal getRadius() const;
+
+protected:
+    void applyFilter();
 
 private:
     static int name_count;
+    static QVector<int> free_ids;
+    static QMultiMap<QString, Node *> name_index;
+    static QSet<Node *> shown_nodes;
+    static RouteGrid grid;
+    int id;
     QString name;
     bool is_highlight;
     std::multiset<PathNode *>paths;
@@ -171,6 +201,7 @@ public:
 class Path : public QTreeWidgetItem{
 public:
     static QSet<Path *> paths;
+    static QVector<Path *> id_paths;
     Path(const QColor &color = QColor(rand() % 256, rand() % 256, rand() % 256));
     ~Path();
     static void resetup();
@@ -178,6 +209,7 @@ public:
     void addNode(const QPointF &pos, const QString &name = QString());
     void showProperty();
     void setHighlight();
+    int getId() const;
     QString getName() const;
     QString *getNamePointer();
     void setName(const QString &newName);
@@ -196,6 +228,8 @@ public:
 
 private:
     static int name_count;
+    static QVector<int> free_ids;
+    int id;
     QString name;
     qreal price;
     qreal time;
@@ -222,10 +256,13 @@ public:
     void openFile(const QString &file_path);
     void saveFile(const QString &file_path = QString());
     void queryFile(const QString &file_path);
+    void preprocess();
     void setEnableScene(bool flag);
     bool getEnableScene();
     void setMode(Mode mode);
     qreal getView_scale() const;
+    int getRoute_size() const;
+    void setRoute_size(int newRoute_size);
     void setOffset(const QPointF &pos);
     void clearHighlight();
     void setHighlightNode(Node *node);
@@ -245,6 +282,9 @@ public:
     void setFile_path(const QString &newFile_path);
     void clearFile_path();
     bool getHave_file_path() const;
+    void clearRouteCache();
+    RouteFile::Format getOutput_format() const;
+    void setOutput_format(RouteFile::Format newOutput_format);
 
 public slots:
     void showListItem(QListWidgetItem *item);
@@ -259,9 +299,13 @@ public slots:
 signals:
     void startNodeChanged(const QString &string);
     void endNodeChanged(const QString &string);
+    void statusChanged(const QString &string);
 
 protected:
     void prt(const QPointF &pos);
+    QString routeString(QVector<QPair<Node *, Path *> > *route, int opt);
+    bool openSnapshot(const RouteSnapshot &snapshot);
+    void saveSnapshot();
     void setDefaultCursor();
     void changeScale(qreal new_scale, const QPointF &pos);
     void cleanProperty();
@@ -283,34 +327,58 @@ private:
     QVector<Edge *> cache_highlight_edges;
     Node *start_node;
     Node *end_node;
+    int route_size;
     bool have_file_path;
     QString file_path;
+    LruCache<std::tuple<int, int, int, unsigned long long>, QByteArray> route_cache;
+    unsigned long long route_cache_version;
+    RouteFile::Format output_format;
 };
 /*** main view end ***/
 
 /*** algorithm start ***/
 class GraphAlgorithm{
 public:
-    GraphAlgorithm();
+    enum Engine{ AStar, Hierarchy, Raptor };
+
+    GraphAlgorithm(Engine engine = AStar);
     QVector<QVector<QPair<Node *, Path *> > *> solve(Node *start_node, Node *end_node, int opt, int size);
+    QVector<QVector<QPair<Node *, Path *> > *> solveBatch(const QVector<int> &opts, const QVector<Node *> &start_nodes, const QVector<Node *> &end_nodes,
+                                                          const std::function<bool(int)> &progress = std::function<bool(int)>(), bool *finished = nullptr);
+    std::vector<std::vector<int> > solvePaths(const QVector<int> &opts, const QVector<Node *> &start_nodes, const QVector<Node *> &end_nodes,
+                                              const std::function<bool(int)> &progress = std::function<bool(int)>(), bool *finished = nullptr);
+    static void invalidate();
+    static void updatePath(Path *path);
+    static RouteNetwork *getNetwork();
+    static RouteHierarchy *getHierarchy(int opt);
+    static bool getPreprocess();
+    static void setPreprocess(bool flag);
+    static bool getRoundBased();
+    static void setRoundBased(bool flag);
+    static qreal getWalkRadius();
+    static qreal getWalkSpeed();
+    static void setWalk(qreal radius, qreal speed);
+    static RouteTreeCache *getTreeCache();
+    Engine getEngine() const;
+    void setEngine(Engine newEngine);
 
 protected:
-    void setup(int tot_node);
-    void dijkstra(int S);
-    void dijkstra_base(int S);
-    void findPaths(int S, int T, int size, QVector<QVector<QPair<Node *, Path *> > *> *ans);
+    QVector<QPair<Node *, Path *> > *decode(const std::vector<int> &path);
+    QVector<QPair<Node *, Path *> > *decode(const std::vector<std::pair<int, int> > &route);
 
 private:
-    int tot_node;
-    std::map<Node *, int> map;
-    std::vector<Node *> id_node;
-    std::vector<Path *> id_path;
-    std::vector<std::vector<std::pair<int, double> > > g;
-    std::vector<std::vector<int> > g_r;
-    std::vector<double> dis;
-    std::vector<std::pair<int, int> > tr;
-    std::vector<std::vector<double> > g2;
-    std::vector<bool> vis;
+    static unsigned long long version;
+    static RouteNetwork network;
+    static RouteHierarchy hierarchy[3];
+    static bool enable_preprocess;
+    static bool enable_rounds;
+    static qreal walk_radius;
+    static qreal walk_speed;
+    static RouteTreeCache trees;
+    Engine engine;
+    RouteNetwork *net;
+    RouteSearch search;
+    RouteRaptor raptor;
 };
 /*** algorithm end ***/
 
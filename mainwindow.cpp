@@ -4,6 +4,7 @@
 #include <QFileDialog>
 #include <QStandardPaths>
 #include <QGraphicsDropShadowEffect>
+#include <QInputDialog>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -46,6 +47,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->swapNodeLabel, &ClickLabel::click_left, ui->graphView, &GraphView::swapStartEndNode);
     connect(ui->graphView, &GraphView::startNodeChanged, ui->startNode, &QLabel::setText);
     connect(ui->graphView, &GraphView::endNodeChanged, ui->endNode, &QLabel::setText);
+    connect(ui->graphView, SIGNAL(statusChanged(QString)), ui->statusBar, SLOT(showMessage(QString)));
     connect(ui->setStartNodeButton, SIGNAL(clicked(bool)), ui->graphView, SLOT(setStartNode()));
     connect(ui->setEndNodeButton, SIGNAL(clicked(bool)), ui->graphView, SLOT(setEndNode()));
     connect(ui->queryButton, &QPushButton::clicked, ui->graphView, &GraphView::queryRoute);
@@ -98,6 +100,11 @@ MainWindow::MainWindow(QWidget *parent)
                             "}");
     ui->toolButton->setMenu(&tool_menu);
     run_menu.addAction(ui->action_batchQuery);
+    run_menu.addAction(ui->action_routeSize);
+    run_menu.addAction(ui->action_preprocess);
+    run_menu.addAction(ui->action_rounds);
+    run_menu.addAction(ui->action_walk);
+    run_menu.addAction(ui->action_outputFormat);
     run_menu.setWindowFlags(file_menu.windowFlags()  | Qt::FramelessWindowHint | Qt::NoDropShadowWindowHint);
     run_menu.setAttribute(Qt::WA_TranslucentBackground);
     run_menu.setStyleSheet("QMenu{"
@@ -289,6 +296,57 @@ void MainWindow::on_action_batchQuery_triggered()
 }
 
 
+void MainWindow::on_action_routeSize_triggered()
+{
+    bool flag = false;
+    int size = QInputDialog::getInt(this, "方案数量", "每次查询列出的方案数：", ui->graphView->getRoute_size(), 1, 20, 1, &flag);
+    if(flag){
+        ui->graphView->setRoute_size(size);
+    }
+}
+
+void MainWindow::on_action_preprocess_toggled(bool checked)
+{
+    GraphAlgorithm::setPreprocess(checked);
+    if(checked){
+        ui->graphView->preprocess();
+    }
+}
+
+void MainWindow::on_action_rounds_toggled(bool checked)
+{
+    GraphAlgorithm::setRoundBased(checked);
+}
+
+void MainWindow::on_action_walk_toggled(bool checked)
+{
+    if(!checked){
+        GraphAlgorithm::setWalk(0, 0);
+        return;
+    }
+    bool flag = false;
+    qreal radius = QInputDialog::getDouble(this, "步行换乘", "步行半径（单位）：", 200, 0.01, 1e6, 2, &flag);
+    if(flag){
+        qreal speed = QInputDialog::getDouble(this, "步行换乘", "步行速度（单位/分钟）：", 50, 0.01, 1e6, 2, &flag);
+        if(flag){
+            GraphAlgorithm::setWalk(radius, speed);
+            return;
+        }
+    }
+    ui->action_walk->setChecked(false);
+}
+
+void MainWindow::on_action_outputFormat_triggered()
+{
+    QStringList items = {"文本", "CSV", "JSON Lines", "二进制"};
+    bool flag = false;
+    QString item = QInputDialog::getItem(this, "输出格式", "批量查询结果格式：", items, ui->graphView->getOutput_format(), false, &flag);
+    if(flag){
+        ui->graphView->setOutput_format(RouteFile::Format(items.indexOf(item)));
+    }
+}
+
+
 void MainWindow::on_closeButton_clicked()
 {
     this->window()->close();
@@ -54,6 +54,16 @@ private slots:
 
     void on_action_batchQuery_triggered();
 
+    void on_action_routeSize_triggered();
+
+    void on_action_preprocess_toggled(bool checked);
+
+    void on_action_rounds_toggled(bool checked);
+
+    void on_action_walk_toggled(bool checked);
+
+    void on_action_outputFormat_triggered();
+
     void on_selectButton_clicked();
 
     void on_addButton_clicked();
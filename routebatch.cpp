@@ -0,0 +1,148 @@
+#include "routebatch.h"
+#include "routesearch.h"
+
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+#define PROGRESS_INTERVAL 50
+
+/*** batch query start ***/
+RouteBatch::RouteBatch()
+    : net(nullptr),
+      hierarchy{nullptr, nullptr, nullptr},
+      thread_count(std::max(1u, std::thread::hardware_concurrency())),
+      jobs(),
+      next(0),
+      done(0),
+      running(0),
+      stop(false)
+{
+
+}
+
+void RouteBatch::setNetwork(RouteNetwork *net)
+{
+    this->net = net;
+}
+
+// A built hierarchy answers the single queries of its strategy, nullptr
+// falls back to the searches GraphAlgorithm uses without preprocessing.
+void RouteBatch::setHierarchy(int opt, const RouteHierarchy *h)
+{
+    hierarchy[opt] = h;
+}
+
+int RouteBatch::getThreadCount() const
+{
+    return thread_count;
+}
+
+void RouteBatch::setThreadCount(int newThreadCount)
+{
+    thread_count = std::max(1, newThreadCount);
+}
+
+// Groups the queries into jobs and builds everything the workers read
+// lazily, so that the network is only read once the threads start.
+void RouteBatch::prepare(const std::vector<Query> &queries)
+{
+    jobs.clear();
+    std::map<std::pair<int, int>, int> group;
+    int tot_stop = net->getStopCount();
+    bool used[3] = {false, false, false};
+    for(int i = 0, size = queries.size(); i < size; i++){
+        const Query &query = queries[i];
+        if(query.opt < 0 || query.opt > 2)continue;
+        if(query.S < 0 || query.S >= tot_stop || query.T < 0 || query.T >= tot_stop)continue;
+        std::pair<int, int> key(query.opt, query.S);
+        std::map<std::pair<int, int>, int>::iterator it = group.find(key);
+        if(it == group.end()){
+            it = group.insert(std::make_pair(key, int(jobs.size()))).first;
+            Job job;
+            job.opt = query.opt;
+            job.S = query.S;
+            jobs.push_back(job);
+        }
+        jobs[it->second].index.push_back(i);
+        used[query.opt] = true;
+    }
+    net->getVertexCount();
+    for(int opt = 0; opt < 3; opt++){
+        if(!used[opt])continue;
+        net->getGraph(opt);
+        if(opt == 2 && hierarchy[opt] == nullptr)net->getLandmarks(opt);
+    }
+}
+
+void RouteBatch::work(const std::vector<Query> &queries, std::vector<std::vector<int> > *paths)
+{
+    RouteSearch search[3];
+    bool ready[3] = {false, false, false};
+    std::vector<int> targets;
+    std::vector<std::vector<int> > res;
+    while(!stop){
+        int k = next++;
+        if(k >= int(jobs.size()))break;
+        const Job &job = jobs[k];
+        RouteSearch &s = search[job.opt];
+        if(!ready[job.opt]){
+            s.setNetwork(net, job.opt);
+            ready[job.opt] = true;
+        }
+        if(job.index.size() == 1){
+            int i = job.index[0];
+            int T = queries[i].T;
+            if(hierarchy[job.opt] != nullptr && job.opt != 0){
+                s.hierarchy(*hierarchy[job.opt], job.S, T, &(*paths)[i]);
+            }
+            else{
+                if(job.opt == 0)s.dijkstra(job.S, T);
+                else s.astar(job.S, T);
+                s.findPath(T, &(*paths)[i]);
+            }
+        }
+        else{
+            targets.clear();
+            for(int i : job.index){
+                targets.push_back(queries[i].T);
+            }
+            s.routes(job.S, targets, &res);
+            for(int j = 0, size = job.index.size(); j < size; j++){
+                (*paths)[job.index[j]].swap(res[j]);
+            }
+        }
+        done += job.index.size();
+    }
+    running--;
+}
+
+// paths[i] is the route of queries[i], empty when it cannot be reached or
+// the query is invalid. Returns false when progress cancelled the run.
+bool RouteBatch::run(const std::vector<Query> &queries, std::vector<std::vector<int> > *paths,
+                     const std::function<bool(int)> &progress)
+{
+    paths->assign(queries.size(), std::vector<int>());
+    if(net == nullptr || queries.empty())return true;
+    prepare(queries);
+    next = 0;
+    done = 0;
+    stop = false;
+    int count = std::min(thread_count, int(jobs.size()));
+    running = count;
+    std::vector<std::thread> workers;
+    for(int i = 0; i < count; i++){
+        workers.push_back(std::thread(&RouteBatch::work, this, std::cref(queries), paths));
+    }
+    while(progress && running > 0){
+        if(!progress(done))stop = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(PROGRESS_INTERVAL));
+    }
+    for(std::thread &worker : workers){
+        worker.join();
+    }
+    if(progress && !stop)progress(done);
+    return !stop;
+}
+/*** batch query end ***/
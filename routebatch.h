@@ -0,0 +1,55 @@
+#ifndef ROUTEBATCH_H
+#define ROUTEBATCH_H
+
+#include "routenetwork.h"
+#include "routehierarchy.h"
+
+#include <vector>
+#include <functional>
+#include <atomic>
+
+/*** batch query start ***/
+// Answers a list of queries on several threads over one compiled network.
+// Queries sharing a strategy and a start are answered by one search, each
+// worker keeps its own RouteSearch per strategy so the scratch arrays are
+// reused from job to job, and the routes come back in the order asked.
+class RouteBatch{
+public:
+    struct Query{
+        int opt;
+        int S;
+        int T;
+    };
+
+    RouteBatch();
+    void setNetwork(RouteNetwork *net);
+    void setHierarchy(int opt, const RouteHierarchy *h);
+    int getThreadCount() const;
+    void setThreadCount(int newThreadCount);
+    // progress is called on the calling thread with the number of queries
+    // answered so far; returning false cancels the jobs not yet started.
+    bool run(const std::vector<Query> &queries, std::vector<std::vector<int> > *paths,
+             const std::function<bool(int)> &progress = std::function<bool(int)>());
+
+protected:
+    struct Job{
+        int opt;
+        int S;
+        std::vector<int> index;
+    };
+    void prepare(const std::vector<Query> &queries);
+    void work(const std::vector<Query> &queries, std::vector<std::vector<int> > *paths);
+
+private:
+    RouteNetwork *net;
+    const RouteHierarchy *hierarchy[3];
+    int thread_count;
+    std::vector<Job> jobs;
+    std::atomic<int> next;
+    std::atomic<int> done;
+    std::atomic<int> running;
+    std::atomic<bool> stop;
+};
+/*** batch query end ***/
+
+#endif // ROUTEBATCH_H
@@ -0,0 +1,192 @@
+#include "routecache.h"
+
+#include <algorithm>
+#include <climits>
+
+#define DEFAULT_BUDGET (size_t(64) << 20)
+
+/*** shortest path tree cache start ***/
+RouteTreeCache::RouteTreeCache()
+    : trees(),
+      budget(DEFAULT_BUDGET),
+      bytes(0),
+      hits(0),
+      misses(0),
+      evictions(0),
+      last_S(-1),
+      last_T(-1)
+{
+
+}
+
+void RouteTreeCache::clear()
+{
+    trees.clear();
+    bytes = 0;
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    last_S = -1;
+    last_T = -1;
+}
+
+size_t RouteTreeCache::getBudget() const
+{
+    return budget;
+}
+
+void RouteTreeCache::setBudget(size_t newBudget)
+{
+    budget = newBudget;
+    while(bytes > budget && !trees.empty()){
+        bytes -= size(trees.back());
+        trees.pop_back();
+        evictions++;
+    }
+}
+
+size_t RouteTreeCache::getBytes() const
+{
+    return bytes;
+}
+
+int RouteTreeCache::getTreeCount() const
+{
+    return trees.size();
+}
+
+long long RouteTreeCache::getHits() const
+{
+    return hits;
+}
+
+long long RouteTreeCache::getMisses() const
+{
+    return misses;
+}
+
+long long RouteTreeCache::getEvictions() const
+{
+    return evictions;
+}
+
+size_t RouteTreeCache::size(const Tree &tree)
+{
+    return sizeof(Tree) + tree.parent.size() * sizeof(int) + tree.dist.size() * sizeof(unsigned long long);
+}
+
+// Drops the trees of older networks, which can never be hit again.
+void RouteTreeCache::evict(RouteNetwork *net)
+{
+    for(std::list<Tree>::iterator it = trees.begin(); it != trees.end(); ){
+        if(it->version != net->getVersion() || it->revision != net->getRevision(it->opt)){
+            bytes -= size(*it);
+            it = trees.erase(it);
+        }
+        else{
+            it++;
+        }
+    }
+}
+
+const RouteTreeCache::Tree *RouteTreeCache::find(RouteNetwork *net, int opt, int root, bool forward)
+{
+    for(std::list<Tree>::iterator it = trees.begin(); it != trees.end(); it++){
+        if(it->root == root && it->forward == forward && it->opt == opt
+                && it->version == net->getVersion() && it->revision == net->getRevision(opt)){
+            trees.splice(trees.begin(), trees, it);
+            return &trees.front();
+        }
+    }
+    return nullptr;
+}
+
+// The tree is built with search when it is not cached. It stays cached
+// even alone over the budget, until the next tree pushes it out.
+const RouteTreeCache::Tree *RouteTreeCache::get(RouteNetwork *net, RouteSearch &search, int opt, int root, bool forward)
+{
+    const Tree *tree = find(net, opt, root, forward);
+    if(tree != nullptr){
+        hits++;
+        return tree;
+    }
+    misses++;
+    evict(net);
+    trees.push_front(Tree());
+    Tree &t = trees.front();
+    t.root = root;
+    t.forward = forward;
+    t.opt = opt;
+    t.version = net->getVersion();
+    t.revision = net->getRevision(opt);
+    search.setNetwork(net, opt);
+    search.tree(root, forward, &t.parent, &t.dist);
+    bytes += size(t);
+    while(bytes > budget && trees.size() > 1){
+        bytes -= size(trees.back());
+        trees.pop_back();
+        evictions++;
+    }
+    return &t;
+}
+
+// Answers S to T from a tree out of S or into T. A tree is only grown when
+// the start or the end repeats the last call, out of S when the start
+// stayed and into T otherwise; a query with neither end cached nor repeated
+// is left to a point-to-point search and false is returned.
+bool RouteTreeCache::route(RouteNetwork *net, RouteSearch &search, int opt, int S, int T, std::vector<int> *path)
+{
+    const Tree *tree = find(net, opt, S, true);
+    if(tree == nullptr)tree = find(net, opt, T, false);
+    if(tree != nullptr){
+        hits++;
+    }
+    else if(S == last_S || T == last_T){
+        tree = S == last_S ? get(net, search, opt, S, true) : get(net, search, opt, T, false);
+    }
+    else{
+        misses++;
+    }
+    last_S = S;
+    last_T = T;
+    if(tree == nullptr)return false;
+    extract(*tree, S, T, path);
+    return true;
+}
+
+// The tree into T, for the exact distances it holds, when it is cached or
+// T ended the last call, grown in the latter case; nullptr otherwise.
+const RouteTreeCache::Tree *RouteTreeCache::target(RouteNetwork *net, RouteSearch &search, int opt, int T)
+{
+    const Tree *tree = find(net, opt, T, false);
+    if(tree != nullptr){
+        hits++;
+    }
+    else if(T == last_T){
+        tree = get(net, search, opt, T, false);
+    }
+    else{
+        misses++;
+    }
+    last_T = T;
+    return tree;
+}
+
+bool RouteTreeCache::extract(const Tree &tree, int S, int T, std::vector<int> *path)
+{
+    path->clear();
+    if(tree.dist[tree.forward ? T : S] == ULLONG_MAX)return false;
+    if(tree.forward){
+        for(int v = T; v >= 0; v = tree.parent[v]){
+            path->push_back(v);
+        }
+        std::reverse(path->begin(), path->end());
+    }
+    else{
+        for(int v = S; v >= 0; v = tree.parent[v]){
+            path->push_back(v);
+        }
+    }
+    return true;
+}
+/*** shortest path tree cache end ***/
@@ -0,0 +1,166 @@
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include "routenetwork.h"
+#include "routesearch.h"
+
+#include <vector>
+#include <list>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+/*** shortest path tree cache start ***/
+// Full shortest path trees kept between queries, most recently used first,
+// keyed by root, direction, strategy and the version and revision of the
+// network. A tree out of a start answers every destination, a tree into an
+// end every start, by walking parents. Trees are evicted from the least
+// recently used end once their size passes the budget.
+class RouteTreeCache{
+public:
+    struct Tree{
+        int root;
+        bool forward;
+        int opt;
+        unsigned long long version;
+        unsigned long long revision;
+        std::vector<int> parent;
+        std::vector<unsigned long long> dist;
+    };
+
+    RouteTreeCache();
+    void clear();
+    size_t getBudget() const;
+    void setBudget(size_t newBudget);
+    size_t getBytes() const;
+    int getTreeCount() const;
+    long long getHits() const;
+    long long getMisses() const;
+    long long getEvictions() const;
+    const Tree *find(RouteNetwork *net, int opt, int root, bool forward);
+    const Tree *get(RouteNetwork *net, RouteSearch &search, int opt, int root, bool forward);
+    bool route(RouteNetwork *net, RouteSearch &search, int opt, int S, int T, std::vector<int> *path);
+    const Tree *target(RouteNetwork *net, RouteSearch &search, int opt, int T);
+    static bool extract(const Tree &tree, int S, int T, std::vector<int> *path);
+
+protected:
+    static size_t size(const Tree &tree);
+    void evict(RouteNetwork *net);
+
+private:
+    std::list<Tree> trees;
+    size_t budget;
+    size_t bytes;
+    long long hits;
+    long long misses;
+    long long evictions;
+    int last_S;
+    int last_T;
+};
+/*** shortest path tree cache end ***/
+
+/*** route result cache start ***/
+// Least recently used map of finished results holding at most capacity
+// entries. Keys carry whatever identifies a result, values are copied in
+// and out, and the counters run until clear.
+template<typename Key, typename Value>
+class LruCache{
+public:
+    LruCache(size_t capacity = 1 << 16)
+        : entries(),
+          index(),
+          capacity(capacity),
+          hits(0),
+          misses(0),
+          evictions(0)
+    {
+
+    }
+
+    void clear()
+    {
+        entries.clear();
+        index.clear();
+        hits = 0;
+        misses = 0;
+        evictions = 0;
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    void setCapacity(size_t newCapacity)
+    {
+        capacity = newCapacity;
+        shrink();
+    }
+
+    size_t getSize() const
+    {
+        return entries.size();
+    }
+
+    long long getHits() const
+    {
+        return hits;
+    }
+
+    long long getMisses() const
+    {
+        return misses;
+    }
+
+    long long getEvictions() const
+    {
+        return evictions;
+    }
+
+    bool find(const Key &key, Value *value)
+    {
+        typename std::map<Key, typename std::list<std::pair<Key, Value> >::iterator>::iterator it = index.find(key);
+        if(it == index.end()){
+            misses++;
+            return false;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        *value = it->second->second;
+        return true;
+    }
+
+    void insert(const Key &key, const Value &value)
+    {
+        typename std::map<Key, typename std::list<std::pair<Key, Value> >::iterator>::iterator it = index.find(key);
+        if(it != index.end()){
+            it->second->second = value;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.push_front(std::make_pair(key, value));
+        index[key] = entries.begin();
+        shrink();
+    }
+
+protected:
+    void shrink()
+    {
+        while(entries.size() > capacity){
+            index.erase(entries.back().first);
+            entries.pop_back();
+            evictions++;
+        }
+    }
+
+private:
+    std::list<std::pair<Key, Value> > entries;
+    std::map<Key, typename std::list<std::pair<Key, Value> >::iterator> index;
+    size_t capacity;
+    long long hits;
+    long long misses;
+    long long evictions;
+};
+/*** route result cache end ***/
+
+#endif // ROUTECACHE_H
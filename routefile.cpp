@@ -0,0 +1,557 @@
+#include "routefile.h"
+
+#include <QStringList>
+#include <QtMath>
+#include <QLocale>
+#include <climits>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#define PIX_SCALE 50000
+#define SNAP_DISTANCE 0.01
+#define READ_CHUNK (1 << 20)
+#define PARALLEL_BYTES (1 << 18)
+#define OUTPUT_BUFFER (1 << 22)
+#define ANSWER_VERSION 1
+#define ANSWER_BYTE_ORDER 0x01020304u
+
+/*** route files start ***/
+RouteFile::Writer::Writer(QIODevice *device)
+    : device(device),
+      buffer(),
+      failed(false)
+{
+    buffer.reserve(OUTPUT_BUFFER + (OUTPUT_BUFFER >> 2));
+}
+
+RouteFile::Writer::~Writer()
+{
+    flush();
+}
+
+void RouteFile::Writer::write(const QByteArray &bytes)
+{
+    buffer.append(bytes);
+    if(buffer.size() >= OUTPUT_BUFFER){
+        flush();
+    }
+}
+
+void RouteFile::Writer::write(const QString &str)
+{
+    write(str.toUtf8());
+}
+
+// CSV and JSON Lines need nothing before the first record but the CSV
+// column names; binary answers start with a magic, version and byte order.
+void RouteFile::Writer::writeHeader(Format format)
+{
+    if(format == Csv){
+        write(QByteArray("query,strategy,start,end,reachable,price,time,distance,transfers,legs\n"));
+    }
+    else if(format == Binary){
+        const char magic[8] = {'O', 'R', 'A', 'N', 'S', '\0', '\0', '\0'};
+        quint32 version = ANSWER_VERSION;
+        quint32 byte_order = ANSWER_BYTE_ORDER;
+        append(magic, sizeof(magic));
+        append(&version, sizeof(version));
+        append(&byte_order, sizeof(byte_order));
+    }
+}
+
+// Writes one record straight from the numbers of the answer. CSV lists the
+// legs in one field as line:from>to joined by |, with 步行 for a walk. The
+// binary record is, in native byte order,
+//     qint64 index, qint32 opt, S, T, reachable,
+//     double price, time, distance, qint32 transfers, leg count,
+//     then qint32 line, from, to for each leg,
+// with stops and lines given by id, as in the network snapshot.
+void RouteFile::Writer::writeAnswer(Format format, const Answer &answer, const std::function<QByteArray(int)> &stop_name,
+                                    const std::function<QByteArray(int)> &line_name)
+{
+    const RouteNetwork::Cost &cost = answer.cost;
+    int transfers = qMax(cost.transfer - 1, 0);
+    if(format == Csv){
+        buffer.append(QByteArray::number(answer.index));
+        buffer.append(',');
+        buffer.append(QByteArray::number(answer.opt));
+        buffer.append(',');
+        appendCsv(answer.start);
+        buffer.append(',');
+        appendCsv(answer.end);
+        buffer.append(cost.reachable ? ",1," : ",0,");
+        appendNumber(cost.price);
+        buffer.append(',');
+        appendNumber(cost.time);
+        buffer.append(',');
+        appendNumber(cost.distance);
+        buffer.append(',');
+        buffer.append(QByteArray::number(transfers));
+        buffer.append(',');
+        QByteArray legs;
+        for(const Leg &leg : answer.legs){
+            if(!legs.isEmpty())legs.append('|');
+            legs.append(leg.line < 0 ? QByteArray("步行") : line_name(leg.line));
+            legs.append(':');
+            legs.append(stop_name(leg.from));
+            legs.append('>');
+            legs.append(stop_name(leg.to));
+        }
+        appendCsv(legs);
+        buffer.append('\n');
+    }
+    else if(format == JsonLines){
+        buffer.append("{\"query\":");
+        buffer.append(QByteArray::number(answer.index));
+        buffer.append(",\"strategy\":");
+        buffer.append(QByteArray::number(answer.opt));
+        buffer.append(",\"start\":");
+        appendJson(answer.start);
+        buffer.append(",\"end\":");
+        appendJson(answer.end);
+        buffer.append(cost.reachable ? ",\"reachable\":true" : ",\"reachable\":false");
+        buffer.append(",\"price\":");
+        appendNumber(cost.price);
+        buffer.append(",\"time\":");
+        appendNumber(cost.time);
+        buffer.append(",\"distance\":");
+        appendNumber(cost.distance);
+        buffer.append(",\"transfers\":");
+        buffer.append(QByteArray::number(transfers));
+        buffer.append(",\"legs\":[");
+        for(size_t i = 0; i < answer.legs.size(); i++){
+            const Leg &leg = answer.legs[i];
+            if(i > 0)buffer.append(',');
+            buffer.append("{\"line\":");
+            if(leg.line < 0)buffer.append("null");
+            else appendJson(line_name(leg.line));
+            buffer.append(",\"from\":");
+            appendJson(stop_name(leg.from));
+            buffer.append(",\"to\":");
+            appendJson(stop_name(leg.to));
+            buffer.append('}');
+        }
+        buffer.append("]}\n");
+    }
+    else if(format == Binary){
+        qint64 index = answer.index;
+        qint32 head[4] = {answer.opt, answer.S, answer.T, cost.reachable ? 1 : 0};
+        double totals[3] = {cost.price, cost.time, cost.distance};
+        qint32 counts[2] = {transfers, qint32(answer.legs.size())};
+        append(&index, sizeof(index));
+        append(head, sizeof(head));
+        append(totals, sizeof(totals));
+        append(counts, sizeof(counts));
+        for(const Leg &leg : answer.legs){
+            qint32 l[3] = {leg.line, leg.from, leg.to};
+            append(l, sizeof(l));
+        }
+    }
+    if(buffer.size() >= OUTPUT_BUFFER){
+        flush();
+    }
+}
+
+void RouteFile::Writer::append(const void *data, qint64 size)
+{
+    buffer.append(static_cast<const char *>(data), size);
+}
+
+void RouteFile::Writer::appendCsv(const QByteArray &field)
+{
+    bool quote = false;
+    for(char c : field){
+        if(c == ',' || c == '"' || c == '\n' || c == '\r'){
+            quote = true;
+            break;
+        }
+    }
+    if(!quote){
+        buffer.append(field);
+        return;
+    }
+    buffer.append('"');
+    for(char c : field){
+        if(c == '"')buffer.append('"');
+        buffer.append(c);
+    }
+    buffer.append('"');
+}
+
+void RouteFile::Writer::appendJson(const QByteArray &str)
+{
+    static const char hex[] = "0123456789abcdef";
+    buffer.append('"');
+    for(char c : str){
+        if(c == '"' || c == '\\'){
+            buffer.append('\\');
+            buffer.append(c);
+        }
+        else if(uchar(c) < 0x20){
+            buffer.append("\\u00");
+            buffer.append(hex[uchar(c) >> 4]);
+            buffer.append(hex[uchar(c) & 15]);
+        }
+        else{
+            buffer.append(c);
+        }
+    }
+    buffer.append('"');
+}
+
+void RouteFile::Writer::appendNumber(double value)
+{
+    buffer.append(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+}
+
+// Returns false once any write has failed. resize rather than clear, which
+// would free the buffer.
+bool RouteFile::Writer::flush()
+{
+    if(!buffer.isEmpty() && device->write(buffer) != buffer.size()){
+        failed = true;
+    }
+    buffer.resize(0);
+    return !failed;
+}
+
+QPointF RouteFile::posToPix(const QPointF &pos)
+{
+    return QPointF(pos.x() * PIX_SCALE, -pos.y() * PIX_SCALE);
+}
+
+QPointF RouteFile::pixToPos(const QPointF &pos)
+{
+    return QPointF(pos.x() / PIX_SCALE, -pos.y() / PIX_SCALE);
+}
+
+// Stops of a network file closer than this in scene units, about 2e-7
+// degrees, are the same stop.
+qreal RouteFile::snapDistance()
+{
+    return SNAP_DISTANCE;
+}
+
+namespace{
+// Cuts the next piece that is not empty off the front of str, the way
+// QString::split with Qt::SkipEmptyParts cuts its pieces.
+bool nextPiece(std::string_view *str, std::string_view sep, std::string_view *piece)
+{
+    while(!str->empty()){
+        size_t pos = str->find(sep);
+        *piece = str->substr(0, pos);
+        str->remove_prefix(pos == std::string_view::npos ? str->size() : pos + sep.size());
+        if(!piece->empty())return true;
+    }
+    return false;
+}
+
+// Keeps the first max pieces of str and returns how many there are in all.
+int splitPieces(std::string_view str, std::string_view sep, std::string_view *pieces, int max)
+{
+    int count = 0;
+    std::string_view piece;
+    while(nextPiece(&str, sep, &piece)){
+        if(count < max)pieces[count] = piece;
+        count++;
+    }
+    return count;
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string_view trimmed(std::string_view str)
+{
+    while(!str.empty() && isSpace(str.front()))str.remove_prefix(1);
+    while(!str.empty() && isSpace(str.back()))str.remove_suffix(1);
+    return str;
+}
+
+// Accepts what QString::toDouble accepts for these files: surrounding
+// blanks and an optional sign.
+bool toDouble(std::string_view str, double *value)
+{
+    str = trimmed(str);
+    if(str.size() > 1 && str[0] == '+' && str[1] != '-' && str[1] != '+'){
+        str.remove_prefix(1);
+    }
+    const char *end = str.data() + str.size();
+    std::from_chars_result result = std::from_chars(str.data(), end, *value);
+    return !str.empty() && result.ec == std::errc() && result.ptr == end;
+}
+}
+
+// Reads one path of a network file from its UTF-8 bytes without copying
+// them; only the names become strings. Stops whose name or position cannot
+// be read are left out; a path with a bad price, time or speed, or no stops
+// at all, is rejected as a whole.
+bool RouteFile::parseLine(std::string_view str, Record *record)
+{
+    std::string_view list[4];
+    str = trimmed(str);
+    if(splitPieces(str, "：", list, 2) < 2)return false;
+    std::string_view name = list[0];
+    if(splitPieces(list[1], "。", list, 4) < 4)return false;
+
+    std::string_view path_list[1];
+    if(splitPieces(list[1], "元", path_list, 1) != 1)return false;
+    if(!toDouble(path_list[0], &record->price) || record->price < 0 || record->price > 100)return false;
+
+    if(splitPieces(list[2], "分钟", path_list, 1) != 1)return false;
+    if(!toDouble(path_list[0], &record->time) || record->time < 0 || record->time > 100)return false;
+
+    if(splitPieces(list[3], "/分钟", path_list, 1) < 1)return false;
+    if(!toDouble(path_list[0], &record->speed) || record->speed < 0 || record->speed > 100)return false;
+
+    record->name = QString::fromUtf8(name.data(), name.size());
+    record->stops.clear();
+    std::string_view stops = list[0];
+    std::string_view s;
+    while(nextPiece(&stops, "；", &s)){
+        std::string_view node_list[2];
+        if(splitPieces(s, "(", node_list, 2) != 2)continue;
+        std::string_view node_name = node_list[0];
+        if(splitPieces(node_list[1], ")", node_list, 1) != 1)continue;
+        if(splitPieces(node_list[0], ",", node_list, 2) != 2)continue;
+        double node_x;
+        if(!toDouble(node_list[0], &node_x) || node_x < INT_MIN / 2 || node_x > INT_MAX / 2)continue;
+        double node_y;
+        if(!toDouble(node_list[1], &node_y) || node_y < INT_MIN / 2 || node_y > INT_MAX / 2)continue;
+        record->stops.push_back(QPair<QString, QPointF> (QString::fromUtf8(node_name.data(), node_name.size()),
+                                                         posToPix(QPointF(node_x, node_y))));
+    }
+    return !record->stops.empty();
+}
+
+bool RouteFile::parseQuery(const QString &str, Query *query)
+{
+    QStringList list = str.split(" ", Qt::SkipEmptyParts);
+    if(list.size() < 3)return false;
+    bool flag = false;
+    query->opt = list[0].toInt(&flag);
+    if(!flag)return false;
+    query->start = list[1];
+    query->end = list[2];
+    return true;
+}
+
+namespace{
+// Parses the whole lines of [begin, end) into records, reusing the records
+// of the last block so that their stop lists keep their capacity.
+void parseRange(const char *begin, const char *end, std::vector<RouteFile::Record> *records, size_t *count)
+{
+    *count = 0;
+    while(begin < end){
+        const char *line_end = static_cast<const char *>(memchr(begin, '\n', end - begin));
+        if(line_end == nullptr)line_end = end;
+        if(*count == records->size())records->emplace_back();
+        if(RouteFile::parseLine(std::string_view(begin, line_end - begin), &(*records)[*count])){
+            ++*count;
+        }
+        begin = line_end + 1;
+    }
+}
+}
+
+// Blocks are read into a reused buffer of READ_CHUNK bytes per thread, which
+// only grows when a single line does not fit. The part of a block after its
+// last line end is carried over to the next one. Small blocks are parsed on
+// the calling thread.
+bool RouteFile::readNetwork(QIODevice *device, const std::function<void(const Record &)> &record,
+                            const std::function<bool(qint64)> &progress, int thread_count)
+{
+    if(thread_count <= 0){
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<char> buffer(size_t(READ_CHUNK) * thread_count);
+    std::vector<std::vector<Record> > records(thread_count);
+    std::vector<size_t> counts(thread_count);
+    std::vector<const char *> bounds(thread_count + 1);
+    size_t used = 0;
+    qint64 bytes = 0;
+    bool at_end = false;
+    while(!at_end){
+        if(used == buffer.size()){
+            buffer.resize(buffer.size() * 2);
+        }
+        qint64 got = device->read(buffer.data() + used, buffer.size() - used);
+        if(got <= 0){
+            at_end = true;
+            got = 0;
+        }
+        bytes += got;
+        size_t size = used + got;
+        size_t whole = size;
+        if(!at_end){
+            while(whole > 0 && buffer[whole - 1] != '\n')whole--;
+        }
+        int parts = std::max(1, std::min(thread_count, int(whole / PARALLEL_BYTES)));
+        bounds[0] = buffer.data();
+        bounds[parts] = buffer.data() + whole;
+        for(int t = 1; t < parts; t++){
+            const char *bound = buffer.data() + whole * t / parts;
+            bound = std::max(bound, bounds[t - 1]);
+            const char *line_end = static_cast<const char *>(memchr(bound, '\n', bounds[parts] - bound));
+            bounds[t] = line_end == nullptr ? bounds[parts] : line_end + 1;
+        }
+        if(parts == 1){
+            parseRange(bounds[0], bounds[1], &records[0], &counts[0]);
+        }
+        else{
+            std::vector<std::thread> workers;
+            for(int t = 0; t < parts; t++){
+                workers.push_back(std::thread(parseRange, bounds[t], bounds[t + 1], &records[t], &counts[t]));
+            }
+            for(std::thread &worker : workers){
+                worker.join();
+            }
+        }
+        for(int t = 0; t < parts; t++){
+            for(size_t i = 0; i < counts[t]; i++){
+                record(records[t][i]);
+            }
+        }
+        used = size - whole;
+        memmove(buffer.data(), buffer.data() + whole, used);
+        if(progress && !at_end && !progress(bytes))return false;
+    }
+    return !progress || progress(bytes);
+}
+
+// Reads up to max_lines trimmed lines of a query file, so a file of any
+// size can be answered one block at a time; 0 means the end of the file.
+int RouteFile::readLines(QIODevice *device, int max_lines, QVector<QByteArray> *lines)
+{
+    lines->clear();
+    while(lines->size() < max_lines && !device->atEnd()){
+        lines->push_back(device->readLine().trimmed());
+    }
+    return lines->size();
+}
+
+bool RouteFile::parseFormat(const QString &str, Format *format)
+{
+    if(str == "text")*format = Text;
+    else if(str == "csv")*format = Csv;
+    else if(str == "jsonl")*format = JsonLines;
+    else if(str == "binary")*format = Binary;
+    else return false;
+    return true;
+}
+
+// The answer file of a query file: ".txt" becomes "_routes_output" and the
+// extension of the format, or that is appended when there is no ".txt".
+QString RouteFile::outputPath(const QString &file_path, Format format)
+{
+    QString suffix = "_routes_output";
+    if(format == Text)suffix += ".txt";
+    else if(format == Csv)suffix += ".csv";
+    else if(format == JsonLines)suffix += ".jsonl";
+    else suffix += ".bin";
+    QString path = QString(file_path).replace(".txt", suffix);
+    if(path == file_path){
+        path += suffix;
+    }
+    return path;
+}
+
+// Fills the totals and legs of answer from a vertex path under answer->opt;
+// an empty path is unreachable with zero totals.
+void RouteFile::answer(RouteNetwork *net, const std::vector<int> &path, Answer *answer)
+{
+    answer->cost = net->measure(path, answer->opt);
+    std::vector<std::pair<int, int> > route;
+    net->itinerary(path, &route);
+    legs(route, &answer->legs);
+}
+
+// Cuts (stop, line) pairs into legs the way routeString groups them: a new
+// ride starts whenever the line changes, and a stop reached on foot is a
+// walk from the stop before it.
+void RouteFile::legs(const std::vector<std::pair<int, int> > &route, std::vector<Leg> *legs)
+{
+    legs->clear();
+    int last_stop = -1;
+    for(const std::pair<int, int> &p : route){
+        if(p.second >= 0){
+            if(legs->empty() || legs->back().line != p.second){
+                legs->push_back(Leg{p.second, p.first, p.first});
+            }
+            legs->back().to = p.first;
+        }
+        else if(last_stop >= 0 && p.first != last_stop){
+            legs->push_back(Leg{-1, last_stop, p.first});
+        }
+        last_stop = p.first;
+    }
+}
+
+// The answer line of a query: the stops of each line in turn with the
+// total of the strategy at the end. Strategy 1 leaves out the fixed time of
+// each line, as in the search.
+QString RouteFile::routeString(const QVector<Hop> &route, int opt, qreal walk_speed)
+{
+    QString str = "";
+    qreal totTime = 0;
+    qreal totPrice = 0;
+    int last_line = -1;
+    int last_stop = -1;
+    QPointF last_pos;
+    bool first_path = true;
+    bool first_node = true;
+    for(const Hop &hop : route){
+        QPointF delta = hop.pos - last_pos;
+        qreal dis = qSqrt(delta.x() * delta.x() + delta.y() * delta.y());
+        if(hop.line >= 0){
+            if(hop.line != last_line){
+                totPrice += hop.price;
+                if(opt != 1){
+                    totTime += hop.time;
+                }
+                if(!first_path){
+                    str += "；";
+                }
+                first_path = false;
+                first_node = true;
+                str += "换乘" + hop.line_name + "：";
+            }
+            if(last_stop >= 0 && hop.stop != last_stop){
+                totTime += dis / hop.speed;
+            }
+            if(!first_node){
+                str += "，";
+            }
+            first_node = false;
+            str += hop.stop_name;
+        }
+        else if(last_stop >= 0 && hop.stop != last_stop){
+            totTime += dis / walk_speed;
+            if(!first_path){
+                str += "；";
+            }
+            first_path = false;
+            str += "步行至" + hop.stop_name;
+        }
+        last_line = hop.line;
+        last_stop = hop.stop;
+        last_pos = hop.pos;
+    }
+    if(opt == 0){
+        str += "。共花费" + QString::number(totPrice) + "元。\n";
+    }
+    else if(opt == 1){
+        str += "。共花费" + QString::number(totTime) + "时间。\n";
+
+    }
+    else if(opt == 2){
+        str += "。共花费" + QString::number(totTime) + "时间。\n";
+    }
+    return str;
+}
+/*** route files end ***/
@@ -0,0 +1,124 @@
+#ifndef ROUTEFILE_H
+#define ROUTEFILE_H
+
+#include "routenetwork.h"
+
+#include <QString>
+#include <QPointF>
+#include <QVector>
+#include <QPair>
+#include <QIODevice>
+#include <QByteArray>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+/*** route files start ***/
+// Text formats shared by the window and the command line router. A network
+// file holds one path per line,
+//     name：stop(x,y)；stop(x,y)。price元。time分钟。speed/分钟
+// and a query file one "strategy start end" per line. Positions are turned
+// into scene units as they are read, which is what speeds are given in.
+// Answers are written as the original prose or, for other programs, as CSV,
+// JSON Lines or fixed-layout binary records.
+class RouteFile{
+public:
+    enum Format{ Text, Csv, JsonLines, Binary };
+
+    struct Record{
+        QString name;
+        qreal price;
+        qreal time;
+        qreal speed;
+        QVector<QPair<QString, QPointF> > stops;
+    };
+    struct Query{
+        int opt;
+        QString start;
+        QString end;
+    };
+    // One stop of a route as routeString lists it; line is -1 for a stop
+    // reached on foot.
+    struct Hop{
+        int stop;
+        QString stop_name;
+        QPointF pos;
+        int line;
+        QString line_name;
+        qreal price;
+        qreal time;
+        qreal speed;
+    };
+    // A ride on one line, or a walk when line is -1, from stop to stop.
+    struct Leg{
+        int line;
+        int from;
+        int to;
+    };
+    // One query line for the machine formats: its number from 1, the
+    // strategy and endpoint names as given, the stops they resolved to (-1
+    // when unknown) and the totals and legs of the route. cost.transfer
+    // counts boardings, as RouteNetwork::measure does.
+    struct Answer{
+        qint64 index;
+        int opt;
+        QByteArray start;
+        QByteArray end;
+        int S;
+        int T;
+        RouteNetwork::Cost cost;
+        std::vector<Leg> legs;
+    };
+
+    // Output of an answer file gathered in one reused buffer and written out
+    // whenever it passes OUTPUT_BUFFER bytes, and once more on flush or
+    // destruction.
+    class Writer{
+    public:
+        explicit Writer(QIODevice *device);
+        ~Writer();
+        void write(const QByteArray &bytes);
+        void write(const QString &str);
+        void writeHeader(Format format);
+        void writeAnswer(Format format, const Answer &answer, const std::function<QByteArray(int)> &stop_name,
+                         const std::function<QByteArray(int)> &line_name);
+        bool flush();
+
+    protected:
+        void append(const void *data, qint64 size);
+        void appendCsv(const QByteArray &field);
+        void appendJson(const QByteArray &str);
+        void appendNumber(double value);
+
+    private:
+        QIODevice *device;
+        QByteArray buffer;
+        bool failed;
+    };
+
+    static QPointF posToPix(const QPointF &pos);
+    static QPointF pixToPos(const QPointF &pos);
+    static qreal snapDistance();
+    static bool parseLine(std::string_view str, Record *record);
+    static bool parseQuery(const QString &str, Query *query);
+    static int readLines(QIODevice *device, int max_lines, QVector<QByteArray> *lines);
+    static bool parseFormat(const QString &str, Format *format);
+    static QString outputPath(const QString &file_path, Format format);
+    static void answer(RouteNetwork *net, const std::vector<int> &path, Answer *answer);
+    static void legs(const std::vector<std::pair<int, int> > &route, std::vector<Leg> *legs);
+    // Reads a network file a block at a time and hands each path that
+    // parses to record, in file order and on the calling thread, so only the
+    // current block is held. Each block is cut at line ends into one range
+    // per thread and the ranges are parsed in parallel; thread_count 0 uses
+    // every hardware thread. progress gets the bytes read so far after each
+    // block and at the end; returning false stops the reading and makes
+    // readNetwork return false.
+    static bool readNetwork(QIODevice *device, const std::function<void(const Record &)> &record,
+                            const std::function<bool(qint64)> &progress = std::function<bool(qint64)>(),
+                            int thread_count = 0);
+    static QString routeString(const QVector<Hop> &route, int opt, qreal walk_speed);
+};
+/*** route files end ***/
+
+#endif // ROUTEFILE_H
@@ -0,0 +1,225 @@
+#include "routegrid.h"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+#define DEFAULT_CELL_SIZE 64
+
+/*** spatial index start ***/
+RouteGrid::RouteGrid()
+    : cell_size(DEFAULT_CELL_SIZE),
+      count(0),
+      px(),
+      py(),
+      used(),
+      cells(),
+      min_cx(0),
+      max_cx(-1),
+      min_cy(0),
+      max_cy(-1)
+{
+
+}
+
+size_t RouteGrid::CellHash::operator()(const std::pair<long long, long long> &c) const
+{
+    return std::hash<long long>()(c.first * 1000003LL ^ c.second);
+}
+
+void RouteGrid::clear()
+{
+    count = 0;
+    px.clear();
+    py.clear();
+    used.clear();
+    cells.clear();
+    min_cx = min_cy = 0;
+    max_cx = max_cy = -1;
+}
+
+double RouteGrid::getCellSize() const
+{
+    return cell_size;
+}
+
+// Changing the cell size refills the grid from the stored positions.
+void RouteGrid::setCellSize(double newCellSize)
+{
+    if(newCellSize <= 0 || newCellSize == cell_size)return;
+    std::vector<double> x = px;
+    std::vector<double> y = py;
+    std::vector<bool> flag = used;
+    clear();
+    cell_size = newCellSize;
+    for(int id = 0, size = flag.size(); id < size; id++){
+        if(flag[id])insert(id, x[id], y[id]);
+    }
+}
+
+int RouteGrid::getSize() const
+{
+    return count;
+}
+
+bool RouteGrid::contains(int id) const
+{
+    return id >= 0 && id < int(used.size()) && used[id];
+}
+
+long long RouteGrid::cell(double v) const
+{
+    return (long long)std::floor(v / cell_size);
+}
+
+double RouteGrid::distance(int id, double x, double y) const
+{
+    double dx = px[id] - x;
+    double dy = py[id] - y;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+void RouteGrid::insert(int id, double x, double y)
+{
+    if(id < 0)return;
+    if(contains(id))remove(id);
+    if(id >= int(used.size())){
+        px.resize(id + 1, 0);
+        py.resize(id + 1, 0);
+        used.resize(id + 1, false);
+    }
+    px[id] = x;
+    py[id] = y;
+    used[id] = true;
+    long long cx = cell(x);
+    long long cy = cell(y);
+    cells[std::make_pair(cx, cy)].push_back(id);
+    if(count == 0){
+        min_cx = max_cx = cx;
+        min_cy = max_cy = cy;
+    }
+    else{
+        min_cx = std::min(min_cx, cx);
+        max_cx = std::max(max_cx, cx);
+        min_cy = std::min(min_cy, cy);
+        max_cy = std::max(max_cy, cy);
+    }
+    count++;
+}
+
+// The extent of the grid is only ever widened, which keeps removal cheap
+// and only costs a few empty rings in later nearest queries.
+void RouteGrid::remove(int id)
+{
+    if(!contains(id))return;
+    std::pair<long long, long long> c(cell(px[id]), cell(py[id]));
+    std::unordered_map<std::pair<long long, long long>, std::vector<int>, CellHash>::iterator it = cells.find(c);
+    if(it != cells.end()){
+        std::vector<int> &ids = it->second;
+        for(int i = 0, size = ids.size(); i < size; i++){
+            if(ids[i] == id){
+                ids[i] = ids.back();
+                ids.pop_back();
+                break;
+            }
+        }
+        if(ids.empty())cells.erase(it);
+    }
+    used[id] = false;
+    count--;
+}
+
+void RouteGrid::scan(long long cx, long long cy, double x, double y, int *best, double *best_dis) const
+{
+    std::unordered_map<std::pair<long long, long long>, std::vector<int>, CellHash>::const_iterator it = cells.find(std::make_pair(cx, cy));
+    if(it == cells.end())return;
+    for(int id : it->second){
+        double d = distance(id, x, y);
+        if(d < *best_dis || (d == *best_dis && (*best < 0 || id < *best))){
+            *best = id;
+            *best_dis = d;
+        }
+    }
+}
+
+// Nearest id within limit of (x, y), the lowest id on ties, or -1. Rings of
+// cells are visited outwards until the next ring cannot hold anything
+// closer; once a ring has more cells than there are ids, the rest is a
+// plain scan.
+int RouteGrid::nearest(double x, double y, double limit) const
+{
+    if(count == 0)return -1;
+    int best = -1;
+    double best_dis = limit;
+    long long cx = cell(x);
+    long long cy = cell(y);
+    long long reach = std::max(std::max(cx - min_cx, max_cx - cx), std::max(cy - min_cy, max_cy - cy));
+    for(long long r = 0; r <= reach; r++){
+        if(r > 0 && (r - 1) * cell_size >= best_dis)break;
+        if(8 * r > count){
+            for(int id = 0, size = used.size(); id < size; id++){
+                if(!used[id])continue;
+                double d = distance(id, x, y);
+                if(d < best_dis || (d == best_dis && (best < 0 || id < best))){
+                    best = id;
+                    best_dis = d;
+                }
+            }
+            break;
+        }
+        if(r == 0){
+            scan(cx, cy, x, y, &best, &best_dis);
+            continue;
+        }
+        for(long long i = -r; i <= r; i++){
+            scan(cx + i, cy - r, x, y, &best, &best_dis);
+            scan(cx + i, cy + r, x, y, &best, &best_dis);
+        }
+        for(long long i = -r + 1; i < r; i++){
+            scan(cx - r, cy + i, x, y, &best, &best_dis);
+            scan(cx + r, cy + i, x, y, &best, &best_dis);
+        }
+    }
+    return best;
+}
+
+// Every id within r of (x, y), in ascending order.
+void RouteGrid::radius(double x, double y, double r, std::vector<int> *ids) const
+{
+    ids->clear();
+    if(count == 0 || r < 0)return;
+    std::vector<int> candidates;
+    box(x - r, y - r, x + r, y + r, &candidates);
+    for(int id : candidates){
+        if(distance(id, x, y) <= r)ids->push_back(id);
+    }
+}
+
+// Every id inside the closed box [x1, x2] x [y1, y2], in ascending order.
+void RouteGrid::box(double x1, double y1, double x2, double y2, std::vector<int> *ids) const
+{
+    ids->clear();
+    if(count == 0 || x1 > x2 || y1 > y2)return;
+    long long cx1 = std::max(cell(x1), min_cx);
+    long long cx2 = std::min(cell(x2), max_cx);
+    long long cy1 = std::max(cell(y1), min_cy);
+    long long cy2 = std::min(cell(y2), max_cy);
+    if(cx1 > cx2 || cy1 > cy2)return;
+    if(double(cx2 - cx1 + 1) * double(cy2 - cy1 + 1) > count){
+        for(int id = 0, size = used.size(); id < size; id++){
+            if(used[id] && px[id] >= x1 && px[id] <= x2 && py[id] >= y1 && py[id] <= y2)ids->push_back(id);
+        }
+        return;
+    }
+    for(long long cx = cx1; cx <= cx2; cx++){
+        for(long long cy = cy1; cy <= cy2; cy++){
+            std::unordered_map<std::pair<long long, long long>, std::vector<int>, CellHash>::const_iterator it = cells.find(std::make_pair(cx, cy));
+            if(it == cells.end())continue;
+            for(int id : it->second){
+                if(px[id] >= x1 && px[id] <= x2 && py[id] >= y1 && py[id] <= y2)ids->push_back(id);
+            }
+        }
+    }
+    std::sort(ids->begin(), ids->end());
+}
+/*** spatial index end ***/
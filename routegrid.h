@@ -0,0 +1,49 @@
+#ifndef ROUTEGRID_H
+#define ROUTEGRID_H
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+
+/*** spatial index start ***/
+// Uniform grid over stop coordinates. Each id lives in the square cell that
+// holds its position, so nearest, radius and box queries only look at the
+// cells around the query instead of every stop, and need no scene.
+class RouteGrid{
+public:
+    RouteGrid();
+    void clear();
+    double getCellSize() const;
+    void setCellSize(double newCellSize);
+    int getSize() const;
+    bool contains(int id) const;
+    void insert(int id, double x, double y);
+    void remove(int id);
+    int nearest(double x, double y, double limit = 1e18) const;
+    void radius(double x, double y, double r, std::vector<int> *ids) const;
+    void box(double x1, double y1, double x2, double y2, std::vector<int> *ids) const;
+
+protected:
+    struct CellHash{
+        size_t operator()(const std::pair<long long, long long> &c) const;
+    };
+    long long cell(double v) const;
+    double distance(int id, double x, double y) const;
+    void scan(long long cx, long long cy, double x, double y, int *best, double *best_dis) const;
+
+private:
+    double cell_size;
+    int count;
+    std::vector<double> px;
+    std::vector<double> py;
+    std::vector<bool> used;
+    std::unordered_map<std::pair<long long, long long>, std::vector<int>, CellHash> cells;
+    long long min_cx;
+    long long max_cx;
+    long long min_cy;
+    long long max_cy;
+};
+/*** spatial index end ***/
+
+#endif // ROUTEGRID_H
@@ -0,0 +1,292 @@
+#include "routehierarchy.h"
+
+#include <queue>
+#include <algorithm>
+#include <climits>
+
+#define IINF ULLONG_MAX
+#define SIMULATE_SETTLE 60
+#define CONTRACT_SETTLE 500
+
+/*** contraction hierarchy start ***/
+RouteHierarchy::RouteHierarchy()
+    : version(0),
+      revision(0),
+      built(false),
+      tot_node(0),
+      tot_shortcut(0),
+      rank(),
+      graph(),
+      up_mid(),
+      down_mid(),
+      out(),
+      in(),
+      depth(),
+      wdis(),
+      wtouched()
+{
+
+}
+
+void RouteHierarchy::clear()
+{
+    version = 0;
+    revision = 0;
+    built = false;
+    tot_node = 0;
+    tot_shortcut = 0;
+    rank.clear();
+    graph = RouteNetwork::Graph();
+    up_mid.clear();
+    down_mid.clear();
+}
+
+unsigned long long RouteHierarchy::getVersion() const
+{
+    return version;
+}
+
+unsigned long long RouteHierarchy::getRevision() const
+{
+    return revision;
+}
+
+bool RouteHierarchy::isBuilt() const
+{
+    return built;
+}
+
+int RouteHierarchy::getShortcutCount() const
+{
+    return tot_shortcut;
+}
+
+const RouteNetwork::Graph &RouteHierarchy::getGraph() const
+{
+    return graph;
+}
+
+void RouteHierarchy::addArc(std::vector<Arc> &arcs, int v, unsigned long long w, int mid)
+{
+    for(Arc &arc : arcs){
+        if(arc.v == v){
+            if(arc.w > w){
+                arc.w = w;
+                arc.mid = mid;
+            }
+            return;
+        }
+    }
+    Arc arc;
+    arc.v = v;
+    arc.w = w;
+    arc.mid = mid;
+    arcs.push_back(arc);
+}
+
+void RouteHierarchy::removeArc(std::vector<Arc> &arcs, int v)
+{
+    for(int i = 0, size = arcs.size(); i < size; i++){
+        if(arcs[i].v == v){
+            arcs[i] = arcs.back();
+            arcs.pop_back();
+            return;
+        }
+    }
+}
+
+// Bounded Dijkstra from S over the vertices not contracted yet, avoiding
+// skip. Gives up after max_settle vertices; a missed witness only costs an
+// unneeded shortcut.
+void RouteHierarchy::witness(int S, int skip, unsigned long long limit, int max_settle)
+{
+    for(int v : wtouched){
+        wdis[v] = IINF;
+    }
+    wtouched.clear();
+    RadixHeap q;
+    wdis[S] = 0;
+    wtouched.push_back(S);
+    q.push(0, S);
+    int settled = 0;
+    while(!q.empty() && settled < max_settle){
+        std::pair<unsigned long long, int> p = q.pop();
+        int u = p.second;
+        if(p.first != wdis[u])continue;
+        if(p.first > limit)break;
+        settled++;
+        for(const Arc &arc : out[u]){
+            if(arc.v == skip)continue;
+            unsigned long long w = wdis[u] + arc.w;
+            if(wdis[arc.v] > w){
+                if(wdis[arc.v] == IINF)wtouched.push_back(arc.v);
+                wdis[arc.v] = w;
+                q.push(w, arc.v);
+            }
+        }
+    }
+}
+
+// Counts, or with simulate unset adds, the shortcuts that contracting v
+// needs. A real contraction also detaches v, leaving out[v] and in[v] as
+// its final upward and downward edges.
+int RouteHierarchy::contract(int v, bool simulate)
+{
+    int count = 0;
+    unsigned long long max_out = 0;
+    for(const Arc &arc : out[v]){
+        max_out = std::max(max_out, arc.w);
+    }
+    for(const Arc &in_arc : in[v]){
+        int u = in_arc.v;
+        witness(u, v, in_arc.w + max_out, simulate ? SIMULATE_SETTLE : CONTRACT_SETTLE);
+        for(const Arc &out_arc : out[v]){
+            int x = out_arc.v;
+            if(x == u)continue;
+            unsigned long long w = in_arc.w + out_arc.w;
+            if(wdis[x] <= w)continue;
+            count++;
+            if(!simulate){
+                addArc(out[u], x, w, v);
+                addArc(in[x], u, w, v);
+            }
+        }
+    }
+    if(!simulate){
+        for(const Arc &arc : in[v]){
+            removeArc(out[arc.v], v);
+            depth[arc.v] = std::max(depth[arc.v], depth[v] + 1);
+        }
+        for(const Arc &arc : out[v]){
+            removeArc(in[arc.v], v);
+            depth[arc.v] = std::max(depth[arc.v], depth[v] + 1);
+        }
+        tot_shortcut += count;
+    }
+    return count;
+}
+
+// Twice the edge difference plus the depth of the hierarchy below v, which
+// keeps contraction spread evenly over the network.
+int RouteHierarchy::priority(int v)
+{
+    return 2 * (contract(v, true) - int(in[v].size() + out[v].size())) + depth[v];
+}
+
+void RouteHierarchy::build(RouteNetwork *net, int opt)
+{
+    const RouteNetwork::Graph &g = net->getGraph(opt);
+    tot_node = net->getVertexCount();
+    tot_shortcut = 0;
+    out.assign(tot_node, std::vector<Arc>());
+    in.assign(tot_node, std::vector<Arc>());
+    depth.assign(tot_node, 0);
+    wdis.assign(tot_node, IINF);
+    wtouched.clear();
+    for(int u = 0; u < tot_node; u++){
+        for(int i = g.offset[u]; i < g.offset[u + 1]; i++){
+            int v = g.target[i];
+            if(v == u || g.iweight[i] == IINF)continue;
+            addArc(out[u], v, g.iweight[i], -1);
+            addArc(in[v], u, g.iweight[i], -1);
+        }
+    }
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >, std::greater<std::pair<int, int> > > q;
+    for(int v = 0; v < tot_node; v++){
+        q.push(std::make_pair(priority(v), v));
+    }
+    rank.assign(tot_node, -1);
+    int level = 0;
+    while(!q.empty()){
+        int v = q.top().second;
+        q.pop();
+        if(rank[v] >= 0)continue;
+        int p = priority(v);
+        if(!q.empty() && p > q.top().first){
+            q.push(std::make_pair(p, v));
+            continue;
+        }
+        contract(v, false);
+        rank[v] = level++;
+    }
+    graph.offset.assign(tot_node + 1, 0);
+    graph.r_offset.assign(tot_node + 1, 0);
+    for(int v = 0; v < tot_node; v++){
+        graph.offset[v + 1] = graph.offset[v] + out[v].size();
+        graph.r_offset[v + 1] = graph.r_offset[v] + in[v].size();
+    }
+    graph.target.clear();
+    graph.weight.clear();
+    graph.iweight.clear();
+    up_mid.clear();
+    graph.r_source.clear();
+    graph.r_weight.clear();
+    graph.r_iweight.clear();
+    down_mid.clear();
+    graph.scale = g.scale;
+    for(int v = 0; v < tot_node; v++){
+        for(const Arc &arc : out[v]){
+            graph.target.push_back(arc.v);
+            graph.weight.push_back(arc.w / g.scale);
+            graph.iweight.push_back(arc.w);
+            up_mid.push_back(arc.mid);
+        }
+        for(const Arc &arc : in[v]){
+            graph.r_source.push_back(arc.v);
+            graph.r_weight.push_back(arc.w / g.scale);
+            graph.r_iweight.push_back(arc.w);
+            down_mid.push_back(arc.mid);
+        }
+    }
+    out.clear();
+    out.shrink_to_fit();
+    in.clear();
+    in.shrink_to_fit();
+    depth.clear();
+    depth.shrink_to_fit();
+    wdis.clear();
+    wdis.shrink_to_fit();
+    version = net->getVersion();
+    revision = net->getRevision(opt);
+    built = true;
+}
+
+// Appends the original vertices of the hierarchy edge u -> v after u,
+// ending with v.
+void RouteHierarchy::unpack(int u, int v, std::vector<int> *path) const
+{
+    std::vector<std::pair<int, int> > stack;
+    stack.push_back(std::make_pair(u, v));
+    while(!stack.empty()){
+        std::pair<int, int> e = stack.back();
+        stack.pop_back();
+        int a = e.first;
+        int b = e.second;
+        int mid = -1;
+        unsigned long long best = IINF;
+        if(rank[a] < rank[b]){
+            for(int i = graph.offset[a]; i < graph.offset[a + 1]; i++){
+                if(graph.target[i] == b && graph.iweight[i] < best){
+                    best = graph.iweight[i];
+                    mid = up_mid[i];
+                }
+            }
+        }
+        else{
+            for(int i = graph.r_offset[b]; i < graph.r_offset[b + 1]; i++){
+                if(graph.r_source[i] == a && graph.r_iweight[i] < best){
+                    best = graph.r_iweight[i];
+                    mid = down_mid[i];
+                }
+            }
+        }
+        if(mid < 0){
+            path->push_back(b);
+        }
+        else{
+            stack.push_back(std::make_pair(mid, b));
+            stack.push_back(std::make_pair(a, mid));
+        }
+    }
+}
+/*** contraction hierarchy end ***/
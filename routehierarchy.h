@@ -0,0 +1,58 @@
+#ifndef ROUTEHIERARCHY_H
+#define ROUTEHIERARCHY_H
+
+#include "routenetwork.h"
+
+#include <vector>
+
+/*** contraction hierarchy start ***/
+// Contraction hierarchy over one strategy of a compiled network. Vertices
+// are contracted in order of edge difference, adding a shortcut u -> w for
+// every u -> v -> w that has no witness path avoiding v. The result is kept
+// as a RouteNetwork::Graph whose forward arrays hold the edges climbing to
+// a higher rank and whose reverse arrays hold the edges coming down from a
+// higher rank, so RouteSearch::hierarchy only ever climbs. Shortcuts add up
+// the fixed-point weights of the strategy, which keep its scale.
+class RouteHierarchy{
+public:
+    RouteHierarchy();
+    void clear();
+    void build(RouteNetwork *net, int opt);
+    unsigned long long getVersion() const;
+    unsigned long long getRevision() const;
+    bool isBuilt() const;
+    int getShortcutCount() const;
+    const RouteNetwork::Graph &getGraph() const;
+    void unpack(int u, int v, std::vector<int> *path) const;
+
+protected:
+    struct Arc{
+        int v;
+        unsigned long long w;
+        int mid;
+    };
+    void addArc(std::vector<Arc> &arcs, int v, unsigned long long w, int mid);
+    void removeArc(std::vector<Arc> &arcs, int v);
+    void witness(int S, int skip, unsigned long long limit, int max_settle);
+    int contract(int v, bool simulate);
+    int priority(int v);
+
+private:
+    unsigned long long version;
+    unsigned long long revision;
+    bool built;
+    int tot_node;
+    int tot_shortcut;
+    std::vector<int> rank;
+    RouteNetwork::Graph graph;
+    std::vector<int> up_mid;
+    std::vector<int> down_mid;
+    std::vector<std::vector<Arc> > out;
+    std::vector<std::vector<Arc> > in;
+    std::vector<int> depth;
+    std::vector<unsigned long long> wdis;
+    std::vector<int> wtouched;
+};
+/*** contraction hierarchy end ***/
+
+#endif // ROUTEHIERARCHY_H
@@ -0,0 +1,604 @@
+#include "routenetwork.h"
+#include "routegrid.h"
+
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+#define LANDMARK_COUNT 4
+#define DEFAULT_SCALE 100
+#define IINF ULLONG_MAX
+#define SLACK 1e-6
+
+/*** radix heap start ***/
+RadixHeap::RadixHeap()
+    : last(0),
+      count(0),
+      buckets()
+{
+
+}
+
+bool RadixHeap::empty() const
+{
+    return count == 0;
+}
+
+int RadixHeap::bucket(unsigned long long key) const
+{
+    unsigned long long x = key ^ last;
+#if defined(__GNUC__)
+    return x == 0 ? 0 : 64 - __builtin_clzll(x);
+#else
+    int b = 0;
+    for(; x != 0; x >>= 1)b++;
+    return b;
+#endif
+}
+
+void RadixHeap::push(unsigned long long key, int v)
+{
+    buckets[bucket(key)].push_back(std::make_pair(key, v));
+    count++;
+}
+
+// The entry with the least key, which moves the smallest bucket holding
+// entries down into bucket 0 when that is empty.
+const std::pair<unsigned long long, int> &RadixHeap::top()
+{
+    if(buckets[0].empty()){
+        int b = 1;
+        while(buckets[b].empty())b++;
+        unsigned long long new_last = buckets[b][0].first;
+        for(const std::pair<unsigned long long, int> &p : buckets[b]){
+            new_last = std::min(new_last, p.first);
+        }
+        last = new_last;
+        for(const std::pair<unsigned long long, int> &p : buckets[b]){
+            buckets[bucket(p.first)].push_back(p);
+        }
+        buckets[b].clear();
+    }
+    return buckets[0].back();
+}
+
+std::pair<unsigned long long, int> RadixHeap::pop()
+{
+    std::pair<unsigned long long, int> p = top();
+    buckets[0].pop_back();
+    count--;
+    return p;
+}
+/*** radix heap end ***/
+
+/*** compiled network start ***/
+RouteNetwork::RouteNetwork()
+    : version(0),
+      stop_x(),
+      stop_y(),
+      lines(),
+      have_layout(false),
+      vertex_stop(),
+      vertex_line(),
+      line_base(),
+      walk_radius(0),
+      walk_speed(0),
+      have_walks(false),
+      walks(),
+      revision{0, 0, 0},
+      scale{DEFAULT_SCALE, DEFAULT_SCALE, DEFAULT_SCALE},
+      have_graph{false, false, false},
+      graph(),
+      have_landmarks{false, false, false},
+      landmarks()
+{
+
+}
+
+void RouteNetwork::clear()
+{
+    version = 0;
+    stop_x.clear();
+    stop_y.clear();
+    lines.clear();
+    have_layout = false;
+    vertex_stop.clear();
+    vertex_line.clear();
+    line_base.clear();
+    have_walks = false;
+    walks.clear();
+    for(int opt = 0; opt < 3; opt++){
+        revision[opt] = 0;
+        have_graph[opt] = false;
+        graph[opt] = Graph();
+        have_landmarks[opt] = false;
+        landmarks[opt] = Landmarks();
+    }
+}
+
+int RouteNetwork::addStop(double x, double y)
+{
+    stop_x.push_back(x);
+    stop_y.push_back(y);
+    have_layout = false;
+    return int(stop_x.size()) - 1;
+}
+
+int RouteNetwork::addLine(double price, double time, double speed, const std::vector<int> &stops)
+{
+    Line line;
+    line.price = price;
+    line.time = time;
+    line.speed = speed;
+    line.stops = stops;
+    lines.push_back(line);
+    have_layout = false;
+    return int(lines.size()) - 1;
+}
+
+unsigned long long RouteNetwork::getVersion() const
+{
+    return version;
+}
+
+void RouteNetwork::setVersion(unsigned long long newVersion)
+{
+    version = newVersion;
+}
+
+int RouteNetwork::getStopCount() const
+{
+    return stop_x.size();
+}
+
+int RouteNetwork::getLineCount() const
+{
+    return lines.size();
+}
+
+const RouteNetwork::Line &RouteNetwork::getLine(int i) const
+{
+    return lines[i];
+}
+
+// Strategy 0 weighs price, 1 speed, 2 time and speed; only the graphs and
+// landmarks of the strategies whose weights change are touched.
+void RouteNetwork::setLine(int i, double price, double time, double speed)
+{
+    Line &line = lines[i];
+    bool changed[3] = {price != line.price, speed != line.speed, time != line.time || speed != line.speed};
+    line.price = price;
+    line.time = time;
+    line.speed = speed;
+    for(int opt = 0; opt < 3; opt++){
+        if(!changed[opt])continue;
+        revision[opt]++;
+        if(have_graph[opt])patch(opt, i);
+        have_landmarks[opt] = false;
+        landmarks[opt] = Landmarks();
+    }
+}
+
+unsigned long long RouteNetwork::getRevision(int opt) const
+{
+    return revision[opt];
+}
+
+int RouteNetwork::getVertexCount()
+{
+    layout();
+    return vertex_stop.size();
+}
+
+int RouteNetwork::getVertexStop(int v)
+{
+    layout();
+    return vertex_stop[v];
+}
+
+int RouteNetwork::getVertexLine(int v)
+{
+    layout();
+    return vertex_line[v];
+}
+
+double RouteNetwork::distance(int a, int b) const
+{
+    if(a < 0 || b < 0)return 0;
+    double x = stop_x[a] - stop_x[b];
+    double y = stop_y[a] - stop_y[b];
+    return std::sqrt(x * x + y * y);
+}
+
+double RouteNetwork::getMaxSpeed() const
+{
+    double max_speed = 0;
+    for(const Line &line : lines){
+        if(line.stops.size() > 1)max_speed = std::fmax(max_speed, line.speed);
+    }
+    if(walk_radius > 0)max_speed = std::fmax(max_speed, walk_speed);
+    return max_speed;
+}
+
+double RouteNetwork::getWalkRadius() const
+{
+    return walk_radius;
+}
+
+double RouteNetwork::getWalkSpeed() const
+{
+    return walk_speed;
+}
+
+// A radius or speed of zero or less leaves the network without footpaths.
+void RouteNetwork::setWalk(double radius, double speed)
+{
+    if(radius <= 0 || speed <= 0)radius = speed = 0;
+    if(walk_radius == radius && walk_speed == speed)return;
+    walk_radius = radius;
+    walk_speed = speed;
+    have_walks = false;
+    walks.clear();
+    for(int opt = 0; opt < 3; opt++){
+        revision[opt]++;
+        have_graph[opt] = false;
+        graph[opt] = Graph();
+        have_landmarks[opt] = false;
+        landmarks[opt] = Landmarks();
+    }
+}
+
+// Pairs of stops a < b joined by a footpath.
+const std::vector<std::pair<int, int> > &RouteNetwork::getWalks()
+{
+    layout();
+    if(!have_walks){
+        buildWalks();
+    }
+    return walks;
+}
+
+RouteNetwork::Cost RouteNetwork::measure(const std::vector<int> &path, int opt)
+{
+    layout();
+    Cost cost;
+    cost.reachable = !path.empty();
+    cost.price = 0;
+    cost.time = 0;
+    cost.distance = 0;
+    cost.transfer = 0;
+    int last_line = -1;
+    int last_stop = -1;
+    int last = -1;
+    for(int v : path){
+        int line = vertex_line[v];
+        int stop = vertex_stop[v];
+        if(line < 0){
+            if(last >= 0 && vertex_line[last] < 0 && vertex_stop[last] != stop){
+                double dis = distance(vertex_stop[last], stop);
+                cost.distance += dis;
+                cost.time += dis / walk_speed;
+                last_line = -1;
+                last_stop = stop;
+            }
+            last = v;
+            continue;
+        }
+        last = v;
+        if(line != last_line){
+            cost.transfer++;
+            cost.price += lines[line].price;
+            if(opt != 1)cost.time += lines[line].time;
+        }
+        if(last_stop >= 0 && stop != last_stop){
+            double dis = distance(last_stop, stop);
+            cost.distance += dis;
+            cost.time += dis / lines[line].speed;
+        }
+        last_line = line;
+        last_stop = stop;
+    }
+    return cost;
+}
+
+// The stops and lines a vertex path visits as (stop, line) pairs without
+// repeats in a row. A walk adds (stop, -1) for the stop it reaches, after
+// (stop, -1) for the stop it leaves when nothing was ridden before it.
+void RouteNetwork::itinerary(const std::vector<int> &path, std::vector<std::pair<int, int> > *route)
+{
+    layout();
+    route->clear();
+    int last = -1;
+    for(int v : path){
+        int line = vertex_line[v];
+        int stop = vertex_stop[v];
+        if(line >= 0){
+            std::pair<int, int> p(stop, line);
+            if(route->empty() || route->back() != p)route->push_back(p);
+        }
+        else if(last >= 0 && vertex_line[last] < 0 && vertex_stop[last] != stop){
+            if(route->empty())route->push_back(std::make_pair(vertex_stop[last], -1));
+            route->push_back(std::make_pair(stop, -1));
+        }
+        last = v;
+    }
+}
+
+double RouteNetwork::getScale(int opt) const
+{
+    return scale[opt];
+}
+
+// Units of the fixed-point weights per unit of cost. Only positive scales
+// are taken, every search runs on these weights.
+void RouteNetwork::setScale(int opt, double newScale)
+{
+    if(newScale <= 0 || scale[opt] == newScale)return;
+    scale[opt] = newScale;
+    have_graph[opt] = false;
+    graph[opt] = Graph();
+    have_landmarks[opt] = false;
+    landmarks[opt] = Landmarks();
+}
+
+// Weights are rounded up, so a lower bound on the cost of a route scaled
+// and rounded down stays below its units; the slack keeps a price such as
+// 0.1 from rounding up past its exact 10 units.
+static unsigned long long quantize(double w, double scale)
+{
+    double x = std::ceil(w * scale - SLACK);
+    if(!std::isfinite(x) || x < 0 || x >= 1e18)return ULLONG_MAX;
+    return (unsigned long long)x;
+}
+
+const RouteNetwork::Graph &RouteNetwork::getGraph(int opt)
+{
+    if(!have_graph[opt]){
+        build(opt);
+    }
+    return graph[opt];
+}
+
+const RouteNetwork::Landmarks &RouteNetwork::getLandmarks(int opt)
+{
+    if(!have_landmarks[opt]){
+        buildLandmarks(opt);
+    }
+    return landmarks[opt];
+}
+
+void RouteNetwork::layout()
+{
+    if(have_layout)return;
+    int tot_stop = stop_x.size();
+    vertex_stop.resize(tot_stop);
+    vertex_line.assign(tot_stop, -1);
+    line_base.resize(lines.size());
+    for(int v = 0; v < tot_stop; v++){
+        vertex_stop[v] = v;
+    }
+    for(int i = 0, size = lines.size(); i < size; i++){
+        line_base[i] = vertex_stop.size();
+        for(int stop : lines[i].stops){
+            for(int k = 0; k < 4; k++){
+                vertex_stop.push_back(stop);
+                vertex_line.push_back(i);
+            }
+        }
+    }
+    have_layout = true;
+    have_walks = false;
+    walks.clear();
+    for(int opt = 0; opt < 3; opt++){
+        have_graph[opt] = false;
+        graph[opt] = Graph();
+        have_landmarks[opt] = false;
+        landmarks[opt] = Landmarks();
+    }
+}
+
+template<typename Emit>
+void RouteNetwork::expand(int opt, Emit emit) const
+{
+    for(int i = 0, size = lines.size(); i < size; i++){
+        expandLine(opt, i, emit);
+    }
+    for(const std::pair<int, int> &p : walks){
+        double w = opt == 0 ? 0 : distance(p.first, p.second) / walk_speed;
+        emit(p.first, p.second, w);
+        emit(p.second, p.first, w);
+    }
+}
+
+template<typename Emit>
+void RouteNetwork::expandLine(int opt, int i, Emit emit) const
+{
+    const Line &line = lines[i];
+    int cnt = line_base[i];
+    int last_stop = -1;
+    for(int j = 0, size = line.stops.size(); j < size; j++){
+        int v = line.stops[j];
+        if(j != 0){
+            if(opt == 0 || opt == 2){
+                emit(cnt + 2, cnt, 0);
+                emit(cnt + 1, cnt + 3, 0);
+            }
+            double w = 0;
+            if(opt == 1 || opt == 2)w = distance(last_stop, v) / line.speed;
+            emit(cnt, cnt - 2, w);
+            emit(cnt - 1, cnt + 1, w);
+        }
+        emit(cnt + 1, v, 0);
+        emit(cnt + 2, v, 0);
+        double w = 0;
+        if(opt == 0)w = line.price;
+        else if(opt == 2)w = line.time;
+        emit(v, cnt, w);
+        emit(v, cnt + 3, w);
+        last_stop = v;
+        cnt += 4;
+    }
+}
+
+void RouteNetwork::build(int opt)
+{
+    getWalks();
+    Graph &g = graph[opt];
+    int tot_vertex = vertex_stop.size();
+    g.offset.assign(tot_vertex + 1, 0);
+    g.r_offset.assign(tot_vertex + 1, 0);
+    expand(opt, [&g](int u, int v, double){
+        g.offset[u + 1]++;
+        g.r_offset[v + 1]++;
+    });
+    for(int u = 0; u < tot_vertex; u++){
+        g.offset[u + 1] += g.offset[u];
+        g.r_offset[u + 1] += g.r_offset[u];
+    }
+    int tot_edge = g.offset[tot_vertex];
+    g.target.resize(tot_edge);
+    g.weight.resize(tot_edge);
+    std::vector<int> pos(g.offset.begin(), g.offset.end() - 1);
+    expand(opt, [&g, &pos](int u, int v, double w){
+        g.target[pos[u]] = v;
+        g.weight[pos[u]] = w;
+        pos[u]++;
+    });
+    g.r_source.resize(tot_edge);
+    g.r_weight.resize(tot_edge);
+    pos.assign(g.r_offset.begin(), g.r_offset.end() - 1);
+    for(int u = 0; u < tot_vertex; u++){
+        for(int i = g.offset[u]; i < g.offset[u + 1]; i++){
+            int v = g.target[i];
+            g.r_source[pos[v]] = u;
+            g.r_weight[pos[v]] = g.weight[i];
+            pos[v]++;
+        }
+    }
+    g.scale = scale[opt];
+    g.iweight.resize(tot_edge);
+    g.r_iweight.resize(tot_edge);
+    for(int i = 0; i < tot_edge; i++){
+        g.iweight[i] = quantize(g.weight[i], g.scale);
+        g.r_iweight[i] = quantize(g.r_weight[i], g.scale);
+    }
+    have_graph[opt] = true;
+}
+// Rewrites the weights of the edges of line i in both directions. Every
+// edge of the line has a line vertex at one end, so it is found by target
+// among the out edges of its tail and by source among the in edges of its
+// head.
+void RouteNetwork::patch(int opt, int i)
+{
+    Graph &g = graph[opt];
+    expandLine(opt, i, [&g](int u, int v, double w){
+        for(int j = g.offset[u]; j < g.offset[u + 1]; j++){
+            if(g.target[j] != v)continue;
+            g.weight[j] = w;
+            g.iweight[j] = quantize(w, g.scale);
+        }
+        for(int j = g.r_offset[v]; j < g.r_offset[v + 1]; j++){
+            if(g.r_source[j] != u)continue;
+            g.r_weight[j] = w;
+            g.r_iweight[j] = quantize(w, g.scale);
+        }
+    });
+}
+
+// Spatial join of the stops on lines over a grid with cells as wide as the
+// radius, so each stop only meets the stops of the cells around it. Stops
+// on no line, like the placeholders of deleted ids, get no footpaths.
+void RouteNetwork::buildWalks()
+{
+    walks.clear();
+    have_walks = true;
+    if(walk_radius <= 0)return;
+    int tot_stop = stop_x.size();
+    std::vector<bool> on_line(tot_stop, false);
+    for(const Line &line : lines){
+        for(int stop : line.stops){
+            on_line[stop] = true;
+        }
+    }
+    RouteGrid grid;
+    grid.setCellSize(std::fmax(walk_radius, 1e-3));
+    for(int a = 0; a < tot_stop; a++){
+        if(on_line[a])grid.insert(a, stop_x[a], stop_y[a]);
+    }
+    std::vector<int> near;
+    for(int a = 0; a < tot_stop; a++){
+        if(!on_line[a])continue;
+        grid.radius(stop_x[a], stop_y[a], walk_radius, &near);
+        for(int b : near){
+            if(b > a)walks.push_back(std::make_pair(a, b));
+        }
+    }
+}
+
+static void fullDijkstra(int S, const std::vector<int> &offset, const std::vector<int> &target,
+                         const std::vector<unsigned long long> &weight, std::vector<unsigned long long> &dis)
+{
+    RadixHeap q;
+    dis.assign(offset.size() - 1, IINF);
+    dis[S] = 0;
+    q.push(0, S);
+    while(!q.empty()){
+        std::pair<unsigned long long, int> p = q.pop();
+        int u = p.second;
+        if(p.first != dis[u])continue;
+        for(int i = offset[u]; i < offset[u + 1]; i++){
+            if(weight[i] == IINF)continue;
+            int v = target[i];
+            if(dis[v] > dis[u] + weight[i]){
+                dis[v] = dis[u] + weight[i];
+                q.push(dis[v], v);
+            }
+        }
+    }
+}
+
+// Picks stop vertices by farthest selection: each new landmark is the
+// reachable stop farthest from the landmarks chosen so far.
+void RouteNetwork::buildLandmarks(int opt)
+{
+    const Graph &g = getGraph(opt);
+    Landmarks &l = landmarks[opt];
+    l = Landmarks();
+    int tot_stop = stop_x.size();
+    int tot_vertex = vertex_stop.size();
+    int first = -1;
+    for(int v = 0; v < tot_stop; v++){
+        if(first < 0 || g.offset[v + 1] - g.offset[v] > g.offset[first + 1] - g.offset[first])first = v;
+    }
+    if(first < 0){
+        have_landmarks[opt] = true;
+        return;
+    }
+    std::vector<std::vector<unsigned long long> > from;
+    std::vector<std::vector<unsigned long long> > to;
+    std::vector<unsigned long long> nearest(tot_stop, IINF);
+    for(int landmark = first; landmark >= 0 && int(l.vertex.size()) < LANDMARK_COUNT; ){
+        l.vertex.push_back(landmark);
+        from.push_back(std::vector<unsigned long long>());
+        to.push_back(std::vector<unsigned long long>());
+        fullDijkstra(landmark, g.offset, g.target, g.iweight, from.back());
+        fullDijkstra(landmark, g.r_offset, g.r_source, g.r_iweight, to.back());
+        landmark = -1;
+        for(int v = 0; v < tot_stop; v++){
+            if(from.back()[v] == IINF)continue;
+            nearest[v] = std::min(nearest[v], from.back()[v]);
+            if(nearest[v] > 0 && (landmark < 0 || nearest[v] > nearest[landmark]))landmark = v;
+        }
+    }
+    int k = l.vertex.size();
+    l.from.resize(size_t(tot_vertex) * k);
+    l.to.resize(size_t(tot_vertex) * k);
+    for(int v = 0; v < tot_vertex; v++){
+        for(int i = 0; i < k; i++){
+            l.from[size_t(v) * k + i] = from[i][v];
+            l.to[size_t(v) * k + i] = to[i][v];
+        }
+    }
+    have_landmarks[opt] = true;
+}
+/*** compiled network end ***/
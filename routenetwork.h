@@ -0,0 +1,141 @@
+#ifndef ROUTENETWORK_H
+#define ROUTENETWORK_H
+
+#include <vector>
+#include <utility>
+
+/*** radix heap start ***/
+// Monotone priority queue over integer keys. An entry sits in the bucket of
+// the highest bit where its key differs from the last key popped, so each
+// entry moves down at most 64 times and no comparisons are needed. Keys
+// pushed must not be below the key of the last entry popped or peeked.
+class RadixHeap{
+public:
+    RadixHeap();
+    bool empty() const;
+    void push(unsigned long long key, int v);
+    const std::pair<unsigned long long, int> &top();
+    std::pair<unsigned long long, int> pop();
+
+protected:
+    int bucket(unsigned long long key) const;
+
+private:
+    unsigned long long last;
+    int count;
+    std::vector<std::pair<unsigned long long, int> > buckets[65];
+};
+/*** radix heap end ***/
+
+/*** compiled network start ***/
+// Expanded routing graph compiled once from the stops and lines of the model.
+// Every stop owns one vertex, every stop on a line owns four more vertices
+// (riding in both directions, boarding and alighting). The graph of each
+// strategy is built on first use and kept until the model version changes;
+// editing the price, time or speed of a line patches its edges in place and
+// bumps the revision of the strategies it affects instead. Stops of lines
+// within the walking radius of each other are joined by footpaths, edges
+// between their stop vertices in both directions that cost no price and
+// take their length over the walking speed.
+class RouteNetwork{
+public:
+    // Compressed sparse row adjacency: the out edges of u are
+    // target/weight[offset[u], offset[u + 1]), the in edges of v are
+    // r_source/r_weight[r_offset[v], r_offset[v + 1]). iweight and r_iweight
+    // hold the same weights in the fixed-point units of the strategy, times
+    // scale rounded up, with ULLONG_MAX for an edge that cannot be used; the
+    // searches run on these alone.
+    struct Graph{
+        std::vector<int> offset;
+        std::vector<int> target;
+        std::vector<double> weight;
+        std::vector<int> r_offset;
+        std::vector<int> r_source;
+        std::vector<double> r_weight;
+        double scale;
+        std::vector<unsigned long long> iweight;
+        std::vector<unsigned long long> r_iweight;
+    };
+    // Landmark distances for ALT lower bounds in fixed-point units:
+    // from[v * k + i] is the distance from landmark i to v and to[v * k + i]
+    // the distance back, ULLONG_MAX where there is no route.
+    struct Landmarks{
+        std::vector<int> vertex;
+        std::vector<unsigned long long> from;
+        std::vector<unsigned long long> to;
+    };
+    // Totals of one route as queryRoute reports them. Strategy 1 ignores the
+    // fixed time of each line, the other strategies add it per boarding.
+    struct Cost{
+        bool reachable;
+        double price;
+        double time;
+        double distance;
+        int transfer;
+    };
+    struct Line{
+        double price;
+        double time;
+        double speed;
+        std::vector<int> stops;
+    };
+
+    RouteNetwork();
+    void clear();
+    int addStop(double x, double y);
+    int addLine(double price, double time, double speed, const std::vector<int> &stops);
+    unsigned long long getVersion() const;
+    void setVersion(unsigned long long newVersion);
+    int getStopCount() const;
+    int getLineCount() const;
+    const Line &getLine(int i) const;
+    void setLine(int i, double price, double time, double speed);
+    unsigned long long getRevision(int opt) const;
+    int getVertexCount();
+    int getVertexStop(int v);
+    int getVertexLine(int v);
+    double distance(int a, int b) const;
+    double getMaxSpeed() const;
+    double getWalkRadius() const;
+    double getWalkSpeed() const;
+    void setWalk(double radius, double speed);
+    const std::vector<std::pair<int, int> > &getWalks();
+    Cost measure(const std::vector<int> &path, int opt);
+    void itinerary(const std::vector<int> &path, std::vector<std::pair<int, int> > *route);
+    double getScale(int opt) const;
+    void setScale(int opt, double newScale);
+    const Graph &getGraph(int opt);
+    const Landmarks &getLandmarks(int opt);
+
+protected:
+    void layout();
+    void build(int opt);
+    template<typename Emit> void expand(int opt, Emit emit) const;
+    template<typename Emit> void expandLine(int opt, int i, Emit emit) const;
+    void patch(int opt, int i);
+    void buildWalks();
+    void buildLandmarks(int opt);
+
+private:
+    unsigned long long version;
+    std::vector<double> stop_x;
+    std::vector<double> stop_y;
+    std::vector<Line> lines;
+    bool have_layout;
+    std::vector<int> vertex_stop;
+    std::vector<int> vertex_line;
+    std::vector<int> line_base;
+    double walk_radius;
+    double walk_speed;
+    bool have_walks;
+    std::vector<std::pair<int, int> > walks;
+    unsigned long long revision[3];
+    double scale[3];
+    bool have_graph[3];
+    Graph graph[3];
+    bool have_landmarks[3];
+    Landmarks landmarks[3];
+};
+/*** compiled network end ***/
+
+#endif // ROUTENETWORK_H
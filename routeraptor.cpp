@@ -0,0 +1,274 @@
+#include "routeraptor.h"
+
+#include <algorithm>
+#include <climits>
+#include <queue>
+#include <functional>
+
+#define INF 1e18
+#define EPS 1e-6
+
+/*** round based search start ***/
+RouteRaptor::RouteRaptor()
+    : net(nullptr),
+      opt(0),
+      indexed(false),
+      version(0),
+      tot_stop(0),
+      walk_radius(0),
+      walk_speed(0),
+      stop_offset(),
+      stop_line(),
+      stop_pos(),
+      walk_offset(),
+      walk_target(),
+      walk_dis(),
+      tau(),
+      leg(),
+      best(),
+      best_round(),
+      prev(),
+      prev_round(),
+      touched(),
+      marked(),
+      is_marked(),
+      first(),
+      last()
+{
+
+}
+
+void RouteRaptor::setNetwork(RouteNetwork *net, int opt)
+{
+    if(this->net != net || !indexed || version != net->getVersion() || tot_stop != net->getStopCount()
+            || int(first.size()) != net->getLineCount() || walk_radius != net->getWalkRadius() || walk_speed != net->getWalkSpeed()){
+        this->net = net;
+        index();
+    }
+    else{
+        reset();
+    }
+    this->opt = opt;
+}
+
+// Lines through every stop with the position of the stop on each, the
+// counterpart of Node::getPaths() over contiguous arrays.
+void RouteRaptor::index()
+{
+    version = net->getVersion();
+    tot_stop = net->getStopCount();
+    int tot_line = net->getLineCount();
+    stop_offset.assign(tot_stop + 1, 0);
+    for(int i = 0; i < tot_line; i++){
+        for(int s : net->getLine(i).stops){
+            stop_offset[s + 1]++;
+        }
+    }
+    for(int s = 0; s < tot_stop; s++){
+        stop_offset[s + 1] += stop_offset[s];
+    }
+    stop_line.resize(stop_offset[tot_stop]);
+    stop_pos.resize(stop_offset[tot_stop]);
+    std::vector<int> pos(stop_offset.begin(), stop_offset.end() - 1);
+    for(int i = 0; i < tot_line; i++){
+        const std::vector<int> &stops = net->getLine(i).stops;
+        for(int j = 0, size = stops.size(); j < size; j++){
+            stop_line[pos[stops[j]]] = i;
+            stop_pos[pos[stops[j]]] = j;
+            pos[stops[j]]++;
+        }
+    }
+    walk_radius = net->getWalkRadius();
+    walk_speed = net->getWalkSpeed();
+    const std::vector<std::pair<int, int> > &walks = net->getWalks();
+    walk_offset.assign(tot_stop + 1, 0);
+    for(const std::pair<int, int> &p : walks){
+        walk_offset[p.first + 1]++;
+        walk_offset[p.second + 1]++;
+    }
+    for(int s = 0; s < tot_stop; s++){
+        walk_offset[s + 1] += walk_offset[s];
+    }
+    walk_target.resize(walk_offset[tot_stop]);
+    walk_dis.resize(walk_offset[tot_stop]);
+    pos.assign(walk_offset.begin(), walk_offset.end() - 1);
+    for(const std::pair<int, int> &p : walks){
+        double dis = net->distance(p.first, p.second);
+        walk_target[pos[p.first]] = p.second;
+        walk_dis[pos[p.first]++] = dis;
+        walk_target[pos[p.second]] = p.first;
+        walk_dis[pos[p.second]++] = dis;
+    }
+    tau.clear();
+    leg.clear();
+    best.assign(tot_stop, INF);
+    best_round.assign(tot_stop, -1);
+    prev.assign(tot_stop, INF);
+    prev_round.assign(tot_stop, -1);
+    touched.clear();
+    marked.clear();
+    is_marked.assign(tot_stop, 0);
+    first.assign(tot_line, INT_MAX);
+    last.assign(tot_line, -1);
+    indexed = true;
+}
+
+void RouteRaptor::reset()
+{
+    for(const std::pair<int, int> &p : touched){
+        tau[p.first][p.second] = INF;
+        best[p.second] = prev[p.second] = INF;
+        best_round[p.second] = prev_round[p.second] = -1;
+    }
+    touched.clear();
+}
+
+double RouteRaptor::board(int line) const
+{
+    if(opt == 0)return net->getLine(line).price;
+    if(opt == 2)return net->getLine(line).time;
+    return 0;
+}
+
+double RouteRaptor::ride(int line, int a, int b) const
+{
+    if(opt == 0)return 0;
+    const RouteNetwork::Line &l = net->getLine(line);
+    return net->distance(l.stops[a], l.stops[b]) / l.speed;
+}
+
+// Records cost as reached in round k, keeping the best of the earlier
+// rounds so later lines of the same round still board from it.
+void RouteRaptor::improve(int k, int s, double cost, const Leg &l)
+{
+    if(best_round[s] != k){
+        prev[s] = best[s];
+        prev_round[s] = best_round[s];
+        best_round[s] = k;
+    }
+    best[s] = cost;
+    tau[k][s] = cost;
+    leg[k][s] = l;
+    touched.push_back(std::make_pair(k, s));
+    if(!is_marked[s]){
+        is_marked[s] = 1;
+        marked.push_back(s);
+    }
+}
+
+// Dijkstra over the footpaths from every stop the rides of round k marked.
+// A stop is only walked on from once it is improved: one that is not was
+// already walked on from in its own round at a lower cost.
+void RouteRaptor::walk(int k, int T)
+{
+    if(walk_target.empty())return;
+    std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int> >, std::greater<std::pair<double, int> > > q;
+    for(int p : marked){
+        q.push(std::make_pair(tau[k][p], p));
+    }
+    while(!q.empty()){
+        std::pair<double, int> top = q.top();
+        q.pop();
+        int p = top.second;
+        if(top.first > tau[k][p])continue;
+        for(int j = walk_offset[p]; j < walk_offset[p + 1]; j++){
+            int s = walk_target[j];
+            double cost = tau[k][p] + (opt == 0 ? 0 : walk_dis[j] / walk_speed);
+            if(cost < best[s] - EPS && cost < best[T] - EPS){
+                Leg l = {-1, p, s, k};
+                improve(k, s, cost, l);
+                q.push(std::make_pair(cost, s));
+            }
+        }
+    }
+}
+
+// One route per number of boardings that beats every route with fewer,
+// listed from the fewest boardings, as (stop, line) pairs like decode.
+// The labels of the previous query are cleared first, so one router can
+// answer any number of queries after a single setNetwork.
+void RouteRaptor::query(int S, int T, std::vector<std::vector<std::pair<int, int> > > *ans)
+{
+    if(S < 0 || T < 0 || S >= tot_stop || T >= tot_stop || S == T)return;
+    reset();
+    if(tau.empty()){
+        tau.push_back(std::vector<double>(tot_stop, INF));
+        leg.push_back(std::vector<Leg>(tot_stop));
+    }
+    std::vector<int> lines;
+    std::vector<int> rounds;
+    marked.clear();
+    Leg none = {-1, -1, -1, -1};
+    improve(0, S, 0, none);
+    walk(0, T);
+    if(tau[0][T] < INF)rounds.push_back(0);
+    for(int k = 1; !marked.empty(); k++){
+        if(int(tau.size()) <= k){
+            tau.push_back(std::vector<double>(tot_stop, INF));
+            leg.push_back(std::vector<Leg>(tot_stop));
+        }
+        lines.clear();
+        for(int p : marked){
+            is_marked[p] = 0;
+            for(int j = stop_offset[p]; j < stop_offset[p + 1]; j++){
+                int line = stop_line[j];
+                if(last[line] < 0)lines.push_back(line);
+                first[line] = std::min(first[line], stop_pos[j]);
+                last[line] = std::max(last[line], stop_pos[j]);
+            }
+        }
+        marked.clear();
+        for(int line : lines){
+            const std::vector<int> &stops = net->getLine(line).stops;
+            for(int dir = 1; dir >= -1; dir -= 2){
+                int begin = dir > 0 ? first[line] : last[line];
+                int end = dir > 0 ? int(stops.size()) : -1;
+                double cur = INF;
+                int from = -1;
+                int from_round = -1;
+                for(int i = begin; i != end; i += dir){
+                    int s = stops[i];
+                    if(from >= 0){
+                        cur += ride(line, i - dir, i);
+                        if(cur < best[s] - EPS && cur < best[T] - EPS){
+                            Leg l = {line, from, i, from_round};
+                            improve(k, s, cur, l);
+                        }
+                    }
+                    double value = best_round[s] == k ? prev[s] : best[s];
+                    if(value < INF && value + board(line) < cur - EPS){
+                        cur = value + board(line);
+                        from = i;
+                        from_round = best_round[s] == k ? prev_round[s] : best_round[s];
+                    }
+                }
+            }
+            first[line] = INT_MAX;
+            last[line] = -1;
+        }
+        walk(k, T);
+        if(tau[k][T] < INF)rounds.push_back(k);
+    }
+    for(int k : rounds){
+        std::vector<std::pair<int, int> > route;
+        for(int s = T, r = k; s != S; ){
+            const Leg &l = leg[r][s];
+            if(l.line < 0){
+                route.push_back(std::make_pair(l.to, -1));
+                if(l.from == S)route.push_back(std::make_pair(S, -1));
+                s = l.from;
+                continue;
+            }
+            const std::vector<int> &stops = net->getLine(l.line).stops;
+            int dir = l.to > l.from ? -1 : 1;
+            for(int i = l.to; i != l.from + dir; i += dir){
+                route.push_back(std::make_pair(stops[i], l.line));
+            }
+            s = stops[l.from];
+            r = l.round;
+        }
+        std::reverse(route.begin(), route.end());
+        ans->push_back(route);
+    }
+}
+/*** round based search end ***/
@@ -0,0 +1,66 @@
+#ifndef ROUTERAPTOR_H
+#define ROUTERAPTOR_H
+
+#include "routenetwork.h"
+
+#include <vector>
+#include <utility>
+
+/*** round based search start ***/
+// Round based router over the stop sequences of the lines, without the
+// expanded graph. Round k scans every line through a stop improved in
+// round k - 1 in both directions, so tau[k][s] is the best cost to reach s
+// with at most k boardings and each round that improves the target gives
+// the cheapest route for its number of boardings. After the lines of a
+// round, the footpaths are walked on from the stops it improved.
+class RouteRaptor{
+public:
+    RouteRaptor();
+    void setNetwork(RouteNetwork *net, int opt);
+    void query(int S, int T, std::vector<std::vector<std::pair<int, int> > > *ans);
+
+protected:
+    // A ride on line from position from to position to, boarded from
+    // round, or with line -1 a walk from stop from to stop to.
+    struct Leg{
+        int line;
+        int from;
+        int to;
+        int round;
+    };
+    void index();
+    void reset();
+    double board(int line) const;
+    double ride(int line, int a, int b) const;
+    void improve(int k, int s, double cost, const Leg &l);
+    void walk(int k, int T);
+
+private:
+    RouteNetwork *net;
+    int opt;
+    bool indexed;
+    unsigned long long version;
+    int tot_stop;
+    double walk_radius;
+    double walk_speed;
+    std::vector<int> stop_offset;
+    std::vector<int> stop_line;
+    std::vector<int> stop_pos;
+    std::vector<int> walk_offset;
+    std::vector<int> walk_target;
+    std::vector<double> walk_dis;
+    std::vector<std::vector<double> > tau;
+    std::vector<std::vector<Leg> > leg;
+    std::vector<double> best;
+    std::vector<int> best_round;
+    std::vector<double> prev;
+    std::vector<int> prev_round;
+    std::vector<std::pair<int, int> > touched;
+    std::vector<int> marked;
+    std::vector<char> is_marked;
+    std::vector<int> first;
+    std::vector<int> last;
+};
+/*** round based search end ***/
+
+#endif // ROUTERAPTOR_H
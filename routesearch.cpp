@@ -0,0 +1,704 @@
+#include "routesearch.h"
+
+#include <queue>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+#include <set>
+
+#define INF 1e18
+#define IINF ULLONG_MAX
+#define UNSET (IINF - 1)
+#define SLACK 1e-6
+#define ROUND_LIMIT 4
+
+/*** route search start ***/
+RouteSearch::RouteSearch()
+    : net(nullptr),
+      g(nullptr),
+      l(nullptr),
+      opt(0),
+      max_speed(0),
+      potential(nullptr),
+      tot_node(0),
+      dis(),
+      dis_r(),
+      pre(),
+      pre_r(),
+      heu(),
+      touched(),
+      mark(),
+      stamp(0),
+      edge_mark(),
+      labels(),
+      bag()
+{
+
+}
+
+void RouteSearch::setNetwork(RouteNetwork *net, int opt)
+{
+    this->net = net;
+    this->opt = opt;
+    g = &net->getGraph(opt);
+    l = nullptr;
+    max_speed = net->getMaxSpeed();
+    if(tot_node != net->getVertexCount()){
+        tot_node = net->getVertexCount();
+        dis.assign(tot_node, IINF);
+        dis_r.assign(tot_node, IINF);
+        pre.assign(tot_node, -1);
+        pre_r.assign(tot_node, -1);
+        heu.assign(tot_node, UNSET);
+        touched.clear();
+        mark.assign(tot_node, 0);
+        stamp = 0;
+    }
+    else{
+        reset();
+    }
+}
+
+void RouteSearch::reset()
+{
+    for(int v : touched){
+        dis[v] = dis_r[v] = IINF;
+        pre[v] = pre_r[v] = -1;
+        heu[v] = UNSET;
+    }
+    touched.clear();
+}
+
+// Cost of a distance in fixed-point units, INF for no route.
+double RouteSearch::unscale(unsigned long long d) const
+{
+    return d == IINF ? INF : d / g->scale;
+}
+
+void RouteSearch::relax(std::vector<unsigned long long> &d, std::vector<int> &p, int v, unsigned long long w, int u)
+{
+    if(dis[v] == IINF && dis_r[v] == IINF)touched.push_back(v);
+    d[v] = w;
+    p[v] = u;
+}
+
+double RouteSearch::getDistance(int v) const
+{
+    return unscale(dis[v]);
+}
+
+// Settles vertices until every vertex no farther than T is final, which is
+// all findPath needs. With T = -1 the whole graph is settled.
+double RouteSearch::dijkstra(int S, int T)
+{
+    reset();
+    RadixHeap q;
+    relax(dis, pre, S, 0, -1);
+    q.push(0, S);
+    while(!q.empty()){
+        std::pair<unsigned long long, int> p = q.pop();
+        if(T >= 0 && p.first > dis[T])break;
+        int u = p.second;
+        if(p.first != dis[u]){
+            continue;
+        }
+        for(int i = g->offset[u]; i < g->offset[u + 1]; i++){
+            if(g->iweight[i] == IINF)continue;
+            int v = g->target[i];
+            unsigned long long w = dis[u] + g->iweight[i];
+            if(dis[v] > w){
+                relax(dis, pre, v, w, u);
+                q.push(w, v);
+            }
+        }
+    }
+    return T >= 0 ? unscale(dis[T]) : 0;
+}
+
+// Searches forward from S and backward from T, alternating on the smaller
+// heap key, and stops once the two keys together reach the best meeting.
+double RouteSearch::bidirectional(int S, int T, std::vector<int> *path)
+{
+    reset();
+    path->clear();
+    RadixHeap q;
+    RadixHeap q_r;
+    relax(dis, pre, S, 0, -1);
+    relax(dis_r, pre_r, T, 0, -1);
+    q.push(0, S);
+    q_r.push(0, T);
+    unsigned long long best = IINF;
+    int meet = -1;
+    if(S == T){
+        best = 0;
+        meet = S;
+    }
+    while(!q.empty() && !q_r.empty()){
+        if(q.top().first + q_r.top().first >= best)break;
+        bool forward = q.top().first <= q_r.top().first;
+        RadixHeap &h = forward ? q : q_r;
+        std::vector<unsigned long long> &d = forward ? dis : dis_r;
+        std::vector<unsigned long long> &d_o = forward ? dis_r : dis;
+        std::vector<int> &p = forward ? pre : pre_r;
+        const std::vector<int> &offset = forward ? g->offset : g->r_offset;
+        const std::vector<int> &target = forward ? g->target : g->r_source;
+        const std::vector<unsigned long long> &weight = forward ? g->iweight : g->r_iweight;
+        std::pair<unsigned long long, int> top = h.pop();
+        int u = top.second;
+        if(top.first != d[u]){
+            continue;
+        }
+        for(int i = offset[u]; i < offset[u + 1]; i++){
+            if(weight[i] == IINF)continue;
+            int v = target[i];
+            unsigned long long w = d[u] + weight[i];
+            if(d[v] > w){
+                relax(d, p, v, w, u);
+                h.push(w, v);
+            }
+            if(d_o[v] != IINF && d[v] + d_o[v] < best){
+                best = d[v] + d_o[v];
+                meet = v;
+            }
+        }
+    }
+    if(meet < 0)return INF;
+    for(int v = meet; v >= 0; v = pre[v]){
+        path->push_back(v);
+    }
+    std::reverse(path->begin(), path->end());
+    for(int v = pre_r[meet]; v >= 0; v = pre_r[v]){
+        path->push_back(v);
+    }
+    return unscale(best);
+}
+
+// Upward search of a contraction hierarchy from both ends. Each side only
+// relaxes edges to higher ranked vertices, and the search ends once neither
+// heap can beat the best meeting vertex.
+double RouteSearch::hierarchy(const RouteHierarchy &h, int S, int T, std::vector<int> *path)
+{
+    reset();
+    path->clear();
+    const RouteNetwork::Graph &up = h.getGraph();
+    RadixHeap q;
+    RadixHeap q_r;
+    relax(dis, pre, S, 0, -1);
+    relax(dis_r, pre_r, T, 0, -1);
+    q.push(0, S);
+    q_r.push(0, T);
+    unsigned long long best = IINF;
+    int meet = -1;
+    while(!q.empty() || !q_r.empty()){
+        bool forward = q_r.empty() || (!q.empty() && q.top().first <= q_r.top().first);
+        RadixHeap &hp = forward ? q : q_r;
+        if(hp.top().first >= best)break;
+        std::vector<unsigned long long> &d = forward ? dis : dis_r;
+        std::vector<unsigned long long> &d_o = forward ? dis_r : dis;
+        std::vector<int> &p = forward ? pre : pre_r;
+        const std::vector<int> &offset = forward ? up.offset : up.r_offset;
+        const std::vector<int> &target = forward ? up.target : up.r_source;
+        const std::vector<unsigned long long> &weight = forward ? up.iweight : up.r_iweight;
+        std::pair<unsigned long long, int> top = hp.pop();
+        int u = top.second;
+        if(top.first != d[u]){
+            continue;
+        }
+        if(d_o[u] != IINF && d[u] + d_o[u] < best){
+            best = d[u] + d_o[u];
+            meet = u;
+        }
+        for(int i = offset[u]; i < offset[u + 1]; i++){
+            int v = target[i];
+            unsigned long long w = d[u] + weight[i];
+            if(d[v] > w){
+                relax(d, p, v, w, u);
+                hp.push(w, v);
+            }
+        }
+    }
+    if(meet < 0)return INF;
+    std::vector<int> chain;
+    for(int v = meet; v >= 0; v = pre[v]){
+        chain.push_back(v);
+    }
+    std::reverse(chain.begin(), chain.end());
+    for(int v = pre_r[meet]; v >= 0; v = pre_r[v]){
+        chain.push_back(v);
+    }
+    path->push_back(chain[0]);
+    for(int i = 1, size = chain.size(); i < size; i++){
+        h.unpack(chain[i - 1], chain[i], path);
+    }
+    return unscale(best);
+}
+
+// Lower bound of the distance from v to T in fixed-point units, IINF when
+// T cannot be reached from v. Strategy 1 weighs a ride by distance over
+// speed, so the straight line at the fastest speed, rounded down, is
+// admissible; the other strategies use the landmarks of the network.
+unsigned long long RouteSearch::heuristic(int v, int T)
+{
+    if(heu[v] != UNSET)return heu[v];
+    unsigned long long h = 0;
+    if(potential != nullptr){
+        h = (*potential)[v];
+    }
+    else if(opt == 1){
+        double x = max_speed > 0 ? std::floor(net->distance(net->getVertexStop(v), net->getVertexStop(T)) / max_speed * g->scale - SLACK) : 0;
+        if(x > 0)h = (unsigned long long)x;
+    }
+    else{
+        if(l == nullptr)l = &net->getLandmarks(opt);
+        int k = l->vertex.size();
+        const unsigned long long *from_v = l->from.data() + size_t(v) * k;
+        const unsigned long long *from_t = l->from.data() + size_t(T) * k;
+        const unsigned long long *to_v = l->to.data() + size_t(v) * k;
+        const unsigned long long *to_t = l->to.data() + size_t(T) * k;
+        for(int i = 0; i < k && h != IINF; i++){
+            // a landmark that reaches v but not T, or is reached from T but
+            // not from v, proves T out of reach
+            if(from_v[i] != IINF && from_t[i] > from_v[i])h = from_t[i] == IINF ? IINF : std::max(h, from_t[i] - from_v[i]);
+            if(to_t[i] != IINF && to_v[i] > to_t[i])h = to_v[i] == IINF ? IINF : std::max(h, to_v[i] - to_t[i]);
+        }
+    }
+    heu[v] = h;
+    return h;
+}
+
+// Same contract as dijkstra(S, T), ordered by distance plus heuristic. The
+// bound of a vertex is raised to that of the vertex it was reached from
+// less the edge between them, which keeps it admissible and the keys of the
+// radix heap from going down where the bound is not consistent.
+double RouteSearch::astar(int S, int T)
+{
+    reset();
+    RadixHeap q;
+    relax(dis, pre, S, 0, -1);
+    if(heuristic(S, T) != IINF)q.push(heu[S], S);
+    while(!q.empty()){
+        std::pair<unsigned long long, int> p = q.pop();
+        if(p.first > dis[T])break;
+        int u = p.second;
+        if(p.first != dis[u] + heu[u]){
+            continue;
+        }
+        for(int i = g->offset[u]; i < g->offset[u + 1]; i++){
+            if(g->iweight[i] == IINF)continue;
+            int v = g->target[i];
+            unsigned long long w = dis[u] + g->iweight[i];
+            if(dis[v] > w){
+                relax(dis, pre, v, w, u);
+                if(heuristic(v, T) == IINF)continue;
+                if(heu[u] > g->iweight[i])heu[v] = std::max(heu[v], heu[u] - g->iweight[i]);
+                q.push(w + heu[v], v);
+            }
+        }
+    }
+    return unscale(dis[T]);
+}
+
+// Reads the route to T off the search tree left by the last search, empty
+// when T was not reached. The tree has no cycles, even where footpaths of
+// zero weight join stops both ways.
+void RouteSearch::findPath(int T, std::vector<int> *path)
+{
+    path->clear();
+    if(dis[T] == IINF)return;
+    for(int v = T; v >= 0; v = pre[v]){
+        path->push_back(v);
+    }
+    std::reverse(path->begin(), path->end());
+}
+
+// A* from S to T that skips the vertices marked and the edges marked with
+// the current stamp, used for the spur searches of kShortest. Where a line
+// can be ridden through a stop, alighting there and boarding it again in
+// the same direction only repeats an itinerary at no lower cost, so that
+// move is skipped.
+unsigned long long RouteSearch::spur(int S, int T)
+{
+    reset();
+    int tot_stop = net->getStopCount();
+    RadixHeap q;
+    relax(dis, pre, S, 0, -1);
+    if(heuristic(S, T) != IINF)q.push(heu[S], S);
+    while(!q.empty()){
+        std::pair<unsigned long long, int> p = q.pop();
+        if(p.first > dis[T])break;
+        int u = p.second;
+        if(p.first != dis[u] + heu[u]){
+            continue;
+        }
+        int through = -1;
+        if(opt != 1 && u < tot_stop && pre[u] >= tot_stop){
+            int a = pre[u];
+            int c = a - (a - tot_stop) % 4;
+            if(a == c + 1)through = c + 3;
+            else if(a == c + 2)through = c;
+        }
+        for(int i = g->offset[u]; i < g->offset[u + 1]; i++){
+            if(edge_mark[i] == stamp || g->iweight[i] == IINF)continue;
+            int v = g->target[i];
+            if(mark[v] == stamp || v == through)continue;
+            unsigned long long w = dis[u] + g->iweight[i];
+            if(dis[v] > w){
+                relax(dis, pre, v, w, u);
+                if(heuristic(v, T) == IINF)continue;
+                if(heu[u] > g->iweight[i])heu[v] = std::max(heu[v], heu[u] - g->iweight[i]);
+                q.push(w + heu[v], v);
+            }
+        }
+    }
+    return dis[T];
+}
+
+// Cost of a vertex path in fixed-point units, with prefix[i] the cost of
+// its first i edges.
+unsigned long long RouteSearch::pathCost(const std::vector<int> &path, std::vector<unsigned long long> *prefix) const
+{
+    prefix->assign(1, 0);
+    for(int i = 0, size = path.size(); i + 1 < size; i++){
+        unsigned long long w = IINF;
+        for(int j = g->offset[path[i]]; j < g->offset[path[i] + 1]; j++){
+            if(g->target[j] == path[i + 1])w = std::min(w, g->iweight[j]);
+        }
+        prefix->push_back(prefix->back() + w);
+    }
+    return prefix->back();
+}
+
+// Up to size loopless routes from S to T by increasing cost, using Yen's
+// algorithm with Lawler's rule of only spurring past the deviation point.
+// Routes that ride the same lines between the same stops as an earlier one
+// are spurred from but not reported, and at most size * ROUND_LIMIT routes
+// are ever taken from the candidates, which are capped to that many.
+void RouteSearch::kShortest(int S, int T, int size, std::vector<std::vector<int> > *ans)
+{
+    if(size <= 0)return;
+    if(edge_mark.size() != g->target.size())edge_mark.assign(g->target.size(), 0);
+    int limit = size * ROUND_LIMIT;
+    std::set<std::pair<unsigned long long, std::vector<int> > > candidates;
+    std::vector<std::vector<int> > found;
+    std::set<std::vector<std::pair<int, int> > > itineraries;
+    stamp++;
+    if(spur(S, T) == IINF)return;
+    std::vector<int> first;
+    for(int v = T; v >= 0; v = pre[v]){
+        first.push_back(v);
+    }
+    std::reverse(first.begin(), first.end());
+    candidates.insert(std::make_pair(dis[T], first));
+    std::vector<unsigned long long> prefix;
+    while(!candidates.empty() && int(ans->size()) < size && int(found.size()) < limit){
+        std::vector<int> path = candidates.begin()->second;
+        candidates.erase(candidates.begin());
+        int dev = 0;
+        for(const std::vector<int> &other : found){
+            int len = 0;
+            while(len < int(path.size()) && len < int(other.size()) && path[len] == other[len])len++;
+            dev = std::max(dev, len - 1);
+        }
+        found.push_back(path);
+        std::vector<std::pair<int, int> > itinerary;
+        for(int v : path){
+            std::pair<int, int> p(net->getVertexStop(v), net->getVertexLine(v));
+            if(p.second >= 0 && (itinerary.empty() || itinerary.back() != p))itinerary.push_back(p);
+        }
+        if(itineraries.insert(itinerary).second)ans->push_back(path);
+        pathCost(path, &prefix);
+        for(int i = dev, len = path.size(); i + 1 < len; i++){
+            stamp++;
+            for(int j = 0; j < i; j++){
+                mark[path[j]] = stamp;
+            }
+            for(const std::vector<int> &other : found){
+                if(int(other.size()) <= i + 1 || !std::equal(path.begin(), path.begin() + i + 1, other.begin()))continue;
+                for(int j = g->offset[path[i]]; j < g->offset[path[i] + 1]; j++){
+                    if(g->target[j] == other[i + 1])edge_mark[j] = stamp;
+                }
+            }
+            unsigned long long d = spur(path[i], T);
+            if(d == IINF)continue;
+            std::vector<int> res;
+            for(int v = T; v != path[i]; v = pre[v]){
+                res.push_back(v);
+            }
+            res.insert(res.end(), path.rend() - i - 1, path.rend());
+            std::reverse(res.begin(), res.end());
+            candidates.insert(std::make_pair(prefix[i] + d, res));
+            while(int(candidates.size() + found.size()) > limit){
+                candidates.erase(std::prev(candidates.end()));
+            }
+        }
+    }
+}
+
+static void toTarget(int T, const RouteNetwork::Graph &g, std::vector<unsigned long long> &d)
+{
+    RadixHeap q;
+    d.assign(g.offset.size() - 1, IINF);
+    d[T] = 0;
+    q.push(0, T);
+    while(!q.empty()){
+        std::pair<unsigned long long, int> p = q.pop();
+        int u = p.second;
+        if(p.first != d[u])continue;
+        for(int i = g.r_offset[u]; i < g.r_offset[u + 1]; i++){
+            if(g.r_iweight[i] == IINF)continue;
+            int v = g.r_source[i];
+            if(d[v] > d[u] + g.r_iweight[i]){
+                d[v] = d[u] + g.r_iweight[i];
+                q.push(d[v], v);
+            }
+        }
+    }
+}
+
+static bool dominates(unsigned long long price, unsigned long long time, int transfer,
+                      unsigned long long price2, unsigned long long time2, int transfer2)
+{
+    return price <= price2 && time <= time2 && transfer <= transfer2;
+}
+
+// Every route from S to T that no other route beats on price, time (with
+// transfer time) and number of boardings at once, ordered by time. Labels
+// run over the price and time graphs, which share their edges, and are
+// settled in order of the least time and price they could reach T with,
+// taken from one backward search on each graph. A label is dropped as soon
+// as one at its vertex is at least as good on all three, or one at T is at
+// least as good as the best it could still reach T with.
+void RouteSearch::pareto(int S, int T, std::vector<std::vector<int> > *ans)
+{
+    const RouteNetwork::Graph &gp = net->getGraph(0);
+    const RouteNetwork::Graph &gt = net->getGraph(2);
+    int tot_stop = net->getStopCount();
+    // A stop other than T needs one more boarding to reach it, unless
+    // footpaths may lead there on foot.
+    bool walks = !net->getWalks().empty();
+    if(int(bag.size()) != tot_node)bag.assign(tot_node, std::vector<int>());
+    std::vector<unsigned long long> price_left;
+    std::vector<unsigned long long> time_left;
+    toTarget(T, gp, price_left);
+    toTarget(T, gt, time_left);
+    if(time_left[S] == IINF)return;
+    labels.clear();
+    std::vector<int> used;
+    typedef std::pair<std::pair<unsigned long long, unsigned long long>, std::pair<int, int> > Key;
+    std::priority_queue<Key, std::vector<Key>, std::greater<Key> > q;
+    Label start;
+    start.price = 0;
+    start.time = 0;
+    start.transfer = 0;
+    start.v = S;
+    start.parent = -1;
+    start.dead = false;
+    labels.push_back(start);
+    bag[S].push_back(0);
+    used.push_back(S);
+    q.push(Key(std::make_pair(time_left[S], price_left[S]), std::make_pair(0, 0)));
+    while(!q.empty()){
+        int id = q.top().second.second;
+        q.pop();
+        if(labels[id].dead)continue;
+        Label cur = labels[id];
+        if(cur.v == T)continue;
+        for(int i = gt.offset[cur.v]; i < gt.offset[cur.v + 1]; i++){
+            if(gp.iweight[i] == IINF || gt.iweight[i] == IINF)continue;
+            int v = gt.target[i];
+            unsigned long long price = cur.price + gp.iweight[i];
+            unsigned long long time = cur.time + gt.iweight[i];
+            int transfer = cur.transfer + (cur.v < tot_stop && v >= tot_stop ? 1 : 0);
+            if(time_left[v] == IINF || price_left[v] == IINF)continue;
+            bool dominated = false;
+            int transfer_left = !walks && v < tot_stop && v != T ? 1 : 0;
+            for(int other : bag[T]){
+                const Label &l = labels[other];
+                if(dominates(l.price, l.time, l.transfer, price + price_left[v], time + time_left[v], transfer + transfer_left))dominated = true;
+            }
+            for(int other : bag[v]){
+                const Label &l = labels[other];
+                if(dominates(l.price, l.time, l.transfer, price, time, transfer))dominated = true;
+            }
+            if(dominated)continue;
+            std::vector<int> &b = bag[v];
+            int keep = 0;
+            for(int other : b){
+                Label &l = labels[other];
+                if(dominates(price, time, transfer, l.price, l.time, l.transfer))l.dead = true;
+                else b[keep++] = other;
+            }
+            b.resize(keep);
+            if(b.empty())used.push_back(v);
+            Label next;
+            next.price = price;
+            next.time = time;
+            next.transfer = transfer;
+            next.v = v;
+            next.parent = id;
+            next.dead = false;
+            b.push_back(labels.size());
+            labels.push_back(next);
+            q.push(Key(std::make_pair(time + time_left[v], price + price_left[v]), std::make_pair(transfer, int(labels.size()) - 1)));
+        }
+    }
+    std::vector<std::pair<std::pair<unsigned long long, unsigned long long>, int> > front;
+    for(int id : bag[T]){
+        front.push_back(std::make_pair(std::make_pair(labels[id].time, labels[id].price), id));
+    }
+    std::sort(front.begin(), front.end());
+    for(const std::pair<std::pair<unsigned long long, unsigned long long>, int> &p : front){
+        std::vector<int> path;
+        for(int id = p.second; id >= 0; id = labels[id].parent){
+            path.push_back(labels[id].v);
+        }
+        std::reverse(path.begin(), path.end());
+        ans->push_back(path);
+    }
+    for(int v : used){
+        bag[v].clear();
+    }
+}
+
+// Dijkstra from S, over the reverse graph unless forward, that stops once
+// every vertex in targets is settled, or runs to the end without targets.
+void RouteSearch::settle(int S, bool forward, const std::vector<int> &targets)
+{
+    reset();
+    stamp++;
+    int remain = 0;
+    for(int v : targets){
+        if(mark[v] != stamp){
+            mark[v] = stamp;
+            remain++;
+        }
+    }
+    std::vector<unsigned long long> &d = forward ? dis : dis_r;
+    std::vector<int> &p = forward ? pre : pre_r;
+    const std::vector<int> &offset = forward ? g->offset : g->r_offset;
+    const std::vector<int> &target = forward ? g->target : g->r_source;
+    const std::vector<unsigned long long> &weight = forward ? g->iweight : g->r_iweight;
+    RadixHeap q;
+    relax(d, p, S, 0, -1);
+    q.push(0, S);
+    while(!q.empty() && (remain > 0 || targets.empty())){
+        std::pair<unsigned long long, int> top = q.pop();
+        int u = top.second;
+        if(top.first != d[u]){
+            continue;
+        }
+        if(mark[u] == stamp){
+            mark[u] = 0;
+            remain--;
+        }
+        for(int i = offset[u]; i < offset[u + 1]; i++){
+            if(weight[i] == IINF)continue;
+            int v = target[i];
+            unsigned long long w = d[u] + weight[i];
+            if(d[v] > w){
+                relax(d, p, v, w, u);
+                q.push(w, v);
+            }
+        }
+    }
+}
+
+// Full shortest path tree from root, or into root over the reverse graph
+// unless forward. parent[v] is the next vertex towards root, -1 for root
+// and for the vertices the tree does not reach, and dist[v] the distance in
+// fixed-point units, ULLONG_MAX where it does not reach.
+void RouteSearch::tree(int root, bool forward, std::vector<int> *parent, std::vector<unsigned long long> *dist)
+{
+    settle(root, forward, std::vector<int>());
+    const std::vector<unsigned long long> &d = forward ? dis : dis_r;
+    const std::vector<int> &p = forward ? pre : pre_r;
+    parent->assign(tot_node, -1);
+    dist->assign(tot_node, IINF);
+    for(int v : touched){
+        (*parent)[v] = p[v];
+        (*dist)[v] = d[v];
+    }
+}
+
+// Exact distances to the target of the next searches, such as those of a
+// reverse tree, replace the geometric and landmark lower bounds of A*.
+// They stay admissible when kShortest removes edges. nullptr restores them.
+void RouteSearch::setPotential(const std::vector<unsigned long long> *potential)
+{
+    this->potential = potential;
+}
+
+// One search from S for all targets. paths[i] is the route to targets[i],
+// empty when it cannot be reached.
+void RouteSearch::routes(int S, const std::vector<int> &targets, std::vector<std::vector<int> > *paths)
+{
+    paths->assign(targets.size(), std::vector<int>());
+    if(targets.empty())return;
+    settle(S, true, targets);
+    for(int i = 0, size = targets.size(); i < size; i++){
+        int T = targets[i];
+        if(dis[T] == IINF)continue;
+        std::vector<int> &path = (*paths)[i];
+        for(int v = T; v >= 0; v = pre[v]){
+            path.push_back(v);
+        }
+        std::reverse(path.begin(), path.end());
+    }
+}
+
+// Costs of the best routes from every source to every target, row by row.
+// Runs one forward search per distinct source, or one backward search per
+// distinct target when there are fewer of those.
+void RouteSearch::matrix(const std::vector<int> &sources, const std::vector<int> &targets, std::vector<RouteNetwork::Cost> *costs)
+{
+    int rows = sources.size();
+    int cols = targets.size();
+    RouteNetwork::Cost none;
+    none.reachable = false;
+    none.price = none.time = none.distance = 0;
+    none.transfer = 0;
+    costs->assign(size_t(rows) * cols, none);
+    std::vector<int> distinct_sources(sources);
+    std::sort(distinct_sources.begin(), distinct_sources.end());
+    distinct_sources.erase(std::unique(distinct_sources.begin(), distinct_sources.end()), distinct_sources.end());
+    std::vector<int> distinct_targets(targets);
+    std::sort(distinct_targets.begin(), distinct_targets.end());
+    distinct_targets.erase(std::unique(distinct_targets.begin(), distinct_targets.end()), distinct_targets.end());
+    bool forward = distinct_sources.size() <= distinct_targets.size();
+    const std::vector<int> &keys = forward ? sources : targets;
+    std::vector<int> order(keys.size());
+    for(int i = 0, size = order.size(); i < size; i++){
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b){
+        return keys[a] < keys[b];
+    });
+    std::vector<int> path;
+    for(int k = 0, size = order.size(); k < size; ){
+        int root = keys[order[k]];
+        settle(root, forward, forward ? distinct_targets : distinct_sources);
+        for(; k < size && keys[order[k]] == root; k++){
+            int other_size = forward ? cols : rows;
+            for(int x = 0; x < other_size; x++){
+                int i = forward ? order[k] : x;
+                int j = forward ? x : order[k];
+                path.clear();
+                if(forward){
+                    if(dis[targets[j]] == IINF)continue;
+                    for(int v = targets[j]; v >= 0; v = pre[v]){
+                        path.push_back(v);
+                    }
+                    std::reverse(path.begin(), path.end());
+                }
+                else{
+                    if(dis_r[sources[i]] == IINF)continue;
+                    for(int v = sources[i]; v >= 0; v = pre_r[v]){
+                        path.push_back(v);
+                    }
+                }
+                (*costs)[size_t(i) * cols + j] = net->measure(path, opt);
+            }
+        }
+    }
+}
+/*** route search end ***/
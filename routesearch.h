@@ -0,0 +1,72 @@
+#ifndef ROUTESEARCH_H
+#define ROUTESEARCH_H
+
+#include "routenetwork.h"
+#include "routehierarchy.h"
+
+#include <vector>
+#include <utility>
+
+/*** route search start ***/
+// Shortest route searches over one strategy of a compiled network. The
+// distance and parent arrays are kept between queries and only the entries
+// touched by the last search are reset, so a query costs what it visits.
+// Every search runs on the fixed-point weights of the strategy over a radix
+// heap, so two routes compare exactly; costs are returned unscaled.
+class RouteSearch{
+public:
+    RouteSearch();
+    void setNetwork(RouteNetwork *net, int opt);
+    double dijkstra(int S, int T = -1);
+    double bidirectional(int S, int T, std::vector<int> *path);
+    double astar(int S, int T);
+    double hierarchy(const RouteHierarchy &h, int S, int T, std::vector<int> *path);
+    void findPath(int T, std::vector<int> *path);
+    void kShortest(int S, int T, int size, std::vector<std::vector<int> > *ans);
+    void pareto(int S, int T, std::vector<std::vector<int> > *ans);
+    void tree(int root, bool forward, std::vector<int> *parent, std::vector<unsigned long long> *dist);
+    void setPotential(const std::vector<unsigned long long> *potential);
+    void routes(int S, const std::vector<int> &targets, std::vector<std::vector<int> > *paths);
+    void matrix(const std::vector<int> &sources, const std::vector<int> &targets, std::vector<RouteNetwork::Cost> *costs);
+    double getDistance(int v) const;
+
+protected:
+    void reset();
+    double unscale(unsigned long long d) const;
+    void relax(std::vector<unsigned long long> &d, std::vector<int> &p, int v, unsigned long long w, int u);
+    unsigned long long heuristic(int v, int T);
+    void settle(int S, bool forward, const std::vector<int> &targets);
+    unsigned long long spur(int S, int T);
+    unsigned long long pathCost(const std::vector<int> &path, std::vector<unsigned long long> *prefix) const;
+
+private:
+    RouteNetwork *net;
+    const RouteNetwork::Graph *g;
+    const RouteNetwork::Landmarks *l;
+    int opt;
+    double max_speed;
+    const std::vector<unsigned long long> *potential;
+    int tot_node;
+    std::vector<unsigned long long> dis;
+    std::vector<unsigned long long> dis_r;
+    std::vector<int> pre;
+    std::vector<int> pre_r;
+    std::vector<unsigned long long> heu;
+    std::vector<int> touched;
+    std::vector<int> mark;
+    int stamp;
+    std::vector<int> edge_mark;
+    struct Label{
+        unsigned long long price;
+        unsigned long long time;
+        int transfer;
+        int v;
+        int parent;
+        bool dead;
+    };
+    std::vector<Label> labels;
+    std::vector<std::vector<int> > bag;
+};
+/*** route search end ***/
+
+#endif // ROUTESEARCH_H
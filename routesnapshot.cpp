@@ -0,0 +1,362 @@
+#include "routesnapshot.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QByteArray>
+#include <climits>
+#include <cstring>
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/*** network snapshot start ***/
+namespace{
+const char SNAPSHOT_MAGIC[8] = {'O', 'R', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+enum Section{
+    StopPos,
+    StopNameOffset,
+    StopNameData,
+    LineAttr,
+    LineNameOffset,
+    LineNameData,
+    LineStopOffset,
+    LineStopData,
+    SectionCount
+};
+
+// Every section starts on an 8 byte boundary, so once the file is mapped
+// the arrays can be read where they lie. section[SectionCount] is the end
+// of the file.
+struct Header{
+    char magic[8];
+    quint32 version;
+    quint32 byte_order;
+    quint64 source_size;
+    qint64 source_time;
+    quint64 size;
+    quint64 checksum;
+    quint32 stop_count;
+    quint32 line_count;
+    quint64 section[SectionCount + 1];
+};
+
+quint64 padded(quint64 size)
+{
+    return (size + 7) & ~quint64(7);
+}
+
+// FNV-1a over 8 byte words; the body is always a whole number of words.
+quint64 checksum(const uchar *data, quint64 size)
+{
+    quint64 hash = 14695981039346656037ull;
+    for(quint64 i = 0; i + 8 <= size; i += 8){
+        quint64 word;
+        memcpy(&word, data + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void append(QByteArray *body, const void *data, qint64 size)
+{
+    body->append(static_cast<const char *>(data), size);
+}
+
+void pad(QByteArray *body)
+{
+    body->append(int(padded(body->size()) - body->size()), '\0');
+}
+}
+
+RouteSnapshot::RouteSnapshot()
+    : file(),
+      data(nullptr),
+      size(0),
+      stop_count(0),
+      line_count(0),
+      stop_pos(nullptr),
+      stop_name_offset(nullptr),
+      stop_name_data(nullptr),
+      line_attr(nullptr),
+      line_name_offset(nullptr),
+      line_name_data(nullptr),
+      line_stop_offset(nullptr),
+      line_stop_data(nullptr)
+{
+
+}
+
+RouteSnapshot::~RouteSnapshot()
+{
+    close();
+}
+
+QString RouteSnapshot::snapshotPath(const QString &file_path)
+{
+    return file_path + ".snap";
+}
+
+bool RouteSnapshot::write(const QString &file_path, const QVector<QPointF> &stop_pos,
+                          const QVector<QString> &stop_names, const QVector<Line> &lines)
+{
+    QFileInfo source(file_path);
+    if(!source.exists() || stop_pos.size() != stop_names.size())return false;
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.source_size = source.size();
+    header.source_time = source.lastModified().toMSecsSinceEpoch();
+    header.stop_count = stop_pos.size();
+    header.line_count = lines.size();
+
+    QByteArray body;
+    quint64 base = sizeof(Header);
+    header.section[StopPos] = base + body.size();
+    for(const QPointF &pos : stop_pos){
+        double xy[2] = {pos.x(), pos.y()};
+        append(&body, xy, sizeof(xy));
+    }
+    QByteArray names;
+    header.section[StopNameOffset] = base + body.size();
+    for(const QString &name : stop_names){
+        quint64 offset = names.size();
+        append(&body, &offset, sizeof(offset));
+        names.append(name.toUtf8());
+    }
+    quint64 offset = names.size();
+    append(&body, &offset, sizeof(offset));
+    header.section[StopNameData] = base + body.size();
+    body.append(names);
+    pad(&body);
+
+    names.clear();
+    header.section[LineAttr] = base + body.size();
+    for(const Line &line : lines){
+        double attr[3] = {line.price, line.time, line.speed};
+        append(&body, attr, sizeof(attr));
+    }
+    header.section[LineNameOffset] = base + body.size();
+    for(const Line &line : lines){
+        offset = names.size();
+        append(&body, &offset, sizeof(offset));
+        names.append(line.name.toUtf8());
+    }
+    offset = names.size();
+    append(&body, &offset, sizeof(offset));
+    header.section[LineNameData] = base + body.size();
+    body.append(names);
+    pad(&body);
+
+    header.section[LineStopOffset] = base + body.size();
+    offset = 0;
+    for(const Line &line : lines){
+        append(&body, &offset, sizeof(offset));
+        offset += line.stops.size();
+    }
+    append(&body, &offset, sizeof(offset));
+    header.section[LineStopData] = base + body.size();
+    for(const Line &line : lines){
+        for(int stop : line.stops){
+            qint32 s = stop;
+            append(&body, &s, sizeof(s));
+        }
+    }
+    pad(&body);
+    header.section[SectionCount] = base + body.size();
+    header.size = header.section[SectionCount];
+    header.checksum = checksum(reinterpret_cast<const uchar *>(body.constData()), body.size());
+
+    QSaveFile out(snapshotPath(file_path));
+    if(!out.open(QIODevice::WriteOnly))return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(body);
+    return out.commit();
+}
+
+bool RouteSnapshot::open(const QString &file_path)
+{
+    close();
+    QFileInfo source(file_path);
+    file.setFileName(snapshotPath(file_path));
+    if(!source.exists() || !file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    size = file.size();
+    data = size >= qint64(sizeof(Header)) ? file.map(0, size) : nullptr;
+    if(data == nullptr){
+        close();
+        return false;
+    }
+    Header header;
+    memcpy(&header, data, sizeof(header));
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+            || header.version != SNAPSHOT_VERSION
+            || header.byte_order != SNAPSHOT_BYTE_ORDER
+            || header.size != quint64(size)
+            || header.source_size != quint64(source.size())
+            || header.source_time != source.lastModified().toMSecsSinceEpoch()
+            || header.stop_count >= INT_MAX || header.line_count >= INT_MAX){
+        close();
+        return false;
+    }
+    quint64 stops = header.stop_count;
+    quint64 lines = header.line_count;
+    // the fixed sized sections must match the counts exactly, the data
+    // sections are checked against their offsets below
+    quint64 expect[SectionCount] = {
+        16 * stops, padded(8 * (stops + 1)), 0,
+        24 * lines, padded(8 * (lines + 1)), 0,
+        padded(8 * (lines + 1)), 0
+    };
+    if(header.section[0] != sizeof(Header) || header.section[SectionCount] != header.size){
+        close();
+        return false;
+    }
+    for(int k = 0; k < SectionCount; k++){
+        quint64 begin = header.section[k];
+        quint64 end = header.section[k + 1];
+        if(end < begin || begin % 8 != 0 || (expect[k] != 0 && end - begin != expect[k])){
+            close();
+            return false;
+        }
+    }
+    if(checksum(data + sizeof(Header), header.size - sizeof(Header)) != header.checksum){
+        close();
+        return false;
+    }
+    stop_count = header.stop_count;
+    line_count = header.line_count;
+    stop_pos = reinterpret_cast<const double *>(data + header.section[StopPos]);
+    stop_name_offset = reinterpret_cast<const quint64 *>(data + header.section[StopNameOffset]);
+    stop_name_data = reinterpret_cast<const char *>(data + header.section[StopNameData]);
+    line_attr = reinterpret_cast<const double *>(data + header.section[LineAttr]);
+    line_name_offset = reinterpret_cast<const quint64 *>(data + header.section[LineNameOffset]);
+    line_name_data = reinterpret_cast<const char *>(data + header.section[LineNameData]);
+    line_stop_offset = reinterpret_cast<const quint64 *>(data + header.section[LineStopOffset]);
+    line_stop_data = reinterpret_cast<const qint32 *>(data + header.section[LineStopData]);
+    if(!validate()){
+        close();
+        return false;
+    }
+    return true;
+}
+
+// The offsets must run forward inside their data sections and every stop of
+// a line must exist, so the accessors need no checks of their own.
+bool RouteSnapshot::validate()
+{
+    quint64 stop_name_size = reinterpret_cast<const char *>(line_attr) - stop_name_data;
+    quint64 line_name_size = reinterpret_cast<const char *>(line_stop_offset) - line_name_data;
+    quint64 line_stop_size = (data + size - reinterpret_cast<const uchar *>(line_stop_data)) / sizeof(qint32);
+    if(stop_name_offset[0] != 0 || line_name_offset[0] != 0 || line_stop_offset[0] != 0){
+        return false;
+    }
+    for(int i = 0; i < stop_count; i++){
+        if(stop_name_offset[i + 1] < stop_name_offset[i] || stop_name_offset[i + 1] > stop_name_size){
+            return false;
+        }
+    }
+    for(int i = 0; i < line_count; i++){
+        if(line_name_offset[i + 1] < line_name_offset[i] || line_name_offset[i + 1] > line_name_size){
+            return false;
+        }
+        if(line_stop_offset[i + 1] < line_stop_offset[i] || line_stop_offset[i + 1] > line_stop_size
+                || line_stop_offset[i + 1] - line_stop_offset[i] >= INT_MAX){
+            return false;
+        }
+    }
+    for(quint64 k = 0, stops = line_stop_offset[line_count]; k < stops; k++){
+        if(line_stop_data[k] < 0 || line_stop_data[k] >= stop_count){
+            return false;
+        }
+    }
+    return true;
+}
+
+void RouteSnapshot::close()
+{
+    if(data != nullptr){
+        file.unmap(const_cast<uchar *>(data));
+    }
+    file.close();
+    data = nullptr;
+    size = 0;
+    stop_count = 0;
+    line_count = 0;
+}
+
+bool RouteSnapshot::isOpen() const
+{
+    return data != nullptr;
+}
+
+int RouteSnapshot::getStopCount() const
+{
+    return stop_count;
+}
+
+int RouteSnapshot::getLineCount() const
+{
+    return line_count;
+}
+
+QPointF RouteSnapshot::getStopPos(int i) const
+{
+    return QPointF(stop_pos[2 * i], stop_pos[2 * i + 1]);
+}
+
+QString RouteSnapshot::getStopName(int i) const
+{
+    return QString::fromUtf8(stop_name_data + stop_name_offset[i], stop_name_offset[i + 1] - stop_name_offset[i]);
+}
+
+QString RouteSnapshot::getLineName(int i) const
+{
+    return QString::fromUtf8(line_name_data + line_name_offset[i], line_name_offset[i + 1] - line_name_offset[i]);
+}
+
+qreal RouteSnapshot::getLinePrice(int i) const
+{
+    return line_attr[3 * i];
+}
+
+qreal RouteSnapshot::getLineTime(int i) const
+{
+    return line_attr[3 * i + 1];
+}
+
+qreal RouteSnapshot::getLineSpeed(int i) const
+{
+    return line_attr[3 * i + 2];
+}
+
+int RouteSnapshot::getLineStopCount(int i) const
+{
+    return line_stop_offset[i + 1] - line_stop_offset[i];
+}
+
+const qint32 *RouteSnapshot::getLineStops(int i) const
+{
+    return line_stop_data + line_stop_offset[i];
+}
+
+// Appends the stops and lines to net in snapshot order, so stop and line
+// ids match the snapshot.
+void RouteSnapshot::load(RouteNetwork *net) const
+{
+    for(int i = 0; i < stop_count; i++){
+        net->addStop(stop_pos[2 * i], stop_pos[2 * i + 1]);
+    }
+    std::vector<int> stops;
+    for(int i = 0; i < line_count; i++){
+        const qint32 *begin = getLineStops(i);
+        stops.assign(begin, begin + getLineStopCount(i));
+        net->addLine(getLinePrice(i), getLineTime(i), getLineSpeed(i), stops);
+    }
+}
+/*** network snapshot end ***/
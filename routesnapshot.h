@@ -0,0 +1,70 @@
+#ifndef ROUTESNAPSHOT_H
+#define ROUTESNAPSHOT_H
+
+#include "routenetwork.h"
+
+#include <QFile>
+#include <QString>
+#include <QPointF>
+#include <QVector>
+#include <vector>
+
+/*** network snapshot start ***/
+// Binary image of a loaded network file, written next to it as
+// "<file>.snap" and mapped into memory on the next open instead of parsing
+// the text again. It holds the merged stops with their scene positions and
+// names and the lines with their attributes and stop sequences, each as a
+// flat array that is read in place. A snapshot is only used when its
+// version and byte order match, the text file still has the size and
+// modification time it was written from and the checksum of the body agrees.
+class RouteSnapshot{
+public:
+    struct Line{
+        QString name;
+        qreal price;
+        qreal time;
+        qreal speed;
+        std::vector<int> stops;
+    };
+
+    RouteSnapshot();
+    ~RouteSnapshot();
+    static QString snapshotPath(const QString &file_path);
+    static bool write(const QString &file_path, const QVector<QPointF> &stop_pos,
+                      const QVector<QString> &stop_names, const QVector<Line> &lines);
+    bool open(const QString &file_path);
+    void close();
+    bool isOpen() const;
+    int getStopCount() const;
+    int getLineCount() const;
+    QPointF getStopPos(int i) const;
+    QString getStopName(int i) const;
+    QString getLineName(int i) const;
+    qreal getLinePrice(int i) const;
+    qreal getLineTime(int i) const;
+    qreal getLineSpeed(int i) const;
+    int getLineStopCount(int i) const;
+    const qint32 *getLineStops(int i) const;
+    void load(RouteNetwork *net) const;
+
+protected:
+    bool validate();
+
+private:
+    QFile file;
+    const uchar *data;
+    qint64 size;
+    int stop_count;
+    int line_count;
+    const double *stop_pos;
+    const quint64 *stop_name_offset;
+    const char *stop_name_data;
+    const double *line_attr;
+    const quint64 *line_name_offset;
+    const char *line_name_data;
+    const quint64 *line_stop_offset;
+    const qint32 *line_stop_data;
+};
+/*** network snapshot end ***/
+
+#endif // ROUTESNAPSHOT_H
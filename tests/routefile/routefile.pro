@@ -0,0 +1,21 @@
+QT       = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_routefile
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_routefile.cpp \
+    ../../routefile.cpp \
+    ../../routegrid.cpp \
+    ../../routenetwork.cpp \
+    ../../routesnapshot.cpp
+
+HEADERS += \
+    ../../routefile.h \
+    ../../routegrid.h \
+    ../../routenetwork.h \
+    ../../routesnapshot.h
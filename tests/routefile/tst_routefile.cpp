@@ -0,0 +1,381 @@
+#include "routefile.h"
+#include "routesnapshot.h"
+#include "routenetwork.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QBuffer>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <random>
+#include <cstring>
+
+/*** route file test start ***/
+namespace{
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()){
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+bool appendFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::Append) || file.write(data) != data.size()){
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+// A network file of line_count lines drawn from seed. Every tenth line is
+// one the parser has to skip: blank, without a speed, or with a price out
+// of range. Returns the number of lines that should be read.
+int networkText(int line_count, unsigned seed, QByteArray *out)
+{
+    std::mt19937 rng(seed);
+    int valid = 0;
+    for(int line = 0; line < line_count; line++){
+        if(line % 10 == 9){
+            switch(line / 10 % 3){
+            case 0:
+                out->append("\n");
+                break;
+            case 1:
+                out->append("线路").append(QByteArray::number(line)).append("：站1(116.1,39.1)。2元。5分钟\n");
+                break;
+            default:
+                out->append("线路").append(QByteArray::number(line)).append("：站1(116.1,39.1)。200元。5分钟。30/分钟\n");
+                break;
+            }
+            continue;
+        }
+        out->append("线路").append(QByteArray::number(line)).append("：");
+        for(int k = 0, size = 2 + rng() % 6; k < size; k++){
+            if(k > 0)out->append("；");
+            out->append("站").append(QByteArray::number(int(rng() % 5000)));
+            out->append('(').append(QByteArray::number(116 + rng() % 10000 / 1e4, 'f', 4));
+            out->append(',').append(QByteArray::number(39 + rng() % 10000 / 1e4, 'f', 4)).append(')');
+        }
+        out->append("。").append(QByteArray::number(int(1 + rng() % 5))).append("元。");
+        out->append(QByteArray::number(int(1 + rng() % 30))).append("分钟。");
+        out->append(QByteArray::number(int(10 + rng() % 90))).append("/分钟\n");
+        valid++;
+    }
+    return valid;
+}
+
+bool readRecords(const QString &path, int thread_count, QVector<RouteFile::Record> *records)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    bool ok = RouteFile::readNetwork(&file, [records](const RouteFile::Record &record){
+        records->push_back(record);
+    }, std::function<bool(qint64)>(), thread_count);
+    file.close();
+    return ok;
+}
+
+// A reachable answer of a ride and a walk, with names that need quoting,
+// and an unreachable one from an unknown stop.
+QVector<RouteFile::Answer> answers()
+{
+    QVector<RouteFile::Answer> list(2);
+    RouteFile::Answer &a = list[0];
+    a.index = 3;
+    a.opt = 1;
+    a.start = "甲,东";
+    a.end = "乙\"站";
+    a.S = 0;
+    a.T = 2;
+    a.cost.reachable = true;
+    a.cost.price = 2;
+    a.cost.time = 12.5;
+    a.cost.distance = 3000;
+    a.cost.transfer = 2;
+    a.legs.push_back(RouteFile::Leg{0, 0, 1});
+    a.legs.push_back(RouteFile::Leg{-1, 1, 2});
+    RouteFile::Answer &b = list[1];
+    b.index = 4;
+    b.opt = 0;
+    b.start = "丁";
+    b.end = "丙";
+    b.S = -1;
+    b.T = 1;
+    b.cost.reachable = false;
+    b.cost.price = b.cost.time = b.cost.distance = 0;
+    b.cost.transfer = 0;
+    return list;
+}
+
+QByteArray writeAnswers(RouteFile::Format format)
+{
+    QBuffer device;
+    device.open(QIODevice::WriteOnly);
+    std::function<QByteArray(int)> stop_name = [](int stop){
+        static const char *names[] = {"甲,东", "丙", "乙\"站"};
+        return QByteArray(names[stop]);
+    };
+    std::function<QByteArray(int)> line_name = [](int){
+        return QByteArray("1路");
+    };
+    RouteFile::Writer writer(&device);
+    writer.writeHeader(format);
+    for(const RouteFile::Answer &answer : answers()){
+        writer.writeAnswer(format, answer, stop_name, line_name);
+    }
+    writer.flush();
+    return device.data();
+}
+
+template<class T> T readField(const QByteArray &data, int *pos)
+{
+    T value;
+    memcpy(&value, data.constData() + *pos, sizeof(T));
+    *pos += sizeof(T);
+    return value;
+}
+}
+
+class RouteFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void snapshotRoundTrip();
+    void snapshotStale();
+    void parseLine_data();
+    void parseLine();
+    void parallelParser_data();
+    void parallelParser();
+    void answerFormats();
+};
+
+// Everything written to a snapshot reads back the same, and loads into a
+// network with the same stops and lines.
+void RouteFileTest::snapshotRoundTrip()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("network.txt");
+    QVERIFY(writeFile(path, "text the snapshot was taken from\n"));
+    std::mt19937 rng(7);
+    QVector<QPointF> stop_pos;
+    QVector<QString> stop_names;
+    for(int i = 0; i < 500; i++){
+        stop_pos.push_back(QPointF(int(rng() % 100000) / 7.0, -int(rng() % 100000) / 3.0));
+        stop_names.push_back(i % 50 == 0 ? QString() : "站点" + QString::number(i));
+    }
+    QVector<RouteSnapshot::Line> lines;
+    for(int i = 0; i < 40; i++){
+        RouteSnapshot::Line line;
+        line.name = "线路" + QString::number(i);
+        line.price = i % 5 * 0.5;
+        line.time = i % 7 + 0.25;
+        line.speed = 10 + i;
+        for(int k = 0, size = i % 9; k < size; k++){
+            line.stops.push_back(rng() % stop_pos.size());
+        }
+        lines.push_back(line);
+    }
+    QVERIFY(RouteSnapshot::write(path, stop_pos, stop_names, lines));
+
+    RouteSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    QVERIFY(snapshot.isOpen());
+    QCOMPARE(snapshot.getStopCount(), int(stop_pos.size()));
+    QCOMPARE(snapshot.getLineCount(), int(lines.size()));
+    for(int i = 0; i < stop_pos.size(); i++){
+        QCOMPARE(snapshot.getStopPos(i), stop_pos[i]);
+        QCOMPARE(snapshot.getStopName(i), stop_names[i]);
+    }
+    for(int i = 0; i < lines.size(); i++){
+        QCOMPARE(snapshot.getLineName(i), lines[i].name);
+        QCOMPARE(snapshot.getLinePrice(i), lines[i].price);
+        QCOMPARE(snapshot.getLineTime(i), lines[i].time);
+        QCOMPARE(snapshot.getLineSpeed(i), lines[i].speed);
+        QCOMPARE(snapshot.getLineStopCount(i), int(lines[i].stops.size()));
+        const qint32 *stops = snapshot.getLineStops(i);
+        QVERIFY(std::vector<int>(stops, stops + snapshot.getLineStopCount(i)) == lines[i].stops);
+    }
+
+    RouteNetwork net;
+    snapshot.load(&net);
+    QCOMPARE(net.getStopCount(), int(stop_pos.size()));
+    QCOMPARE(net.getLineCount(), int(lines.size()));
+    for(int i = 0; i < lines.size(); i++){
+        QCOMPARE(net.getLine(i).price, lines[i].price);
+        QCOMPARE(net.getLine(i).time, lines[i].time);
+        QCOMPARE(net.getLine(i).speed, lines[i].speed);
+        QVERIFY(net.getLine(i).stops == lines[i].stops);
+    }
+    snapshot.close();
+    QVERIFY(!snapshot.isOpen());
+}
+
+// A snapshot is refused once its text file changes, and a damaged one is
+// refused outright.
+void RouteFileTest::snapshotStale()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("network.txt");
+    QVERIFY(writeFile(path, "text\n"));
+    QVector<RouteSnapshot::Line> lines;
+    lines.push_back(RouteSnapshot::Line{"线路", 2, 5, 30, std::vector<int>{0, 1}});
+    QVERIFY(RouteSnapshot::write(path, QVector<QPointF>{QPointF(1, 2), QPointF(3, 4)}, QVector<QString>{"甲", "乙"}, lines));
+    RouteSnapshot snapshot;
+    QVERIFY(snapshot.open(path));
+    snapshot.close();
+
+    QVERIFY(appendFile(path, "more text\n"));
+    QVERIFY(!snapshot.open(path));
+
+    QVERIFY(RouteSnapshot::write(path, QVector<QPointF>{QPointF(1, 2), QPointF(3, 4)}, QVector<QString>{"甲", "乙"}, lines));
+    QFile file(RouteSnapshot::snapshotPath(path));
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QByteArray data = file.readAll();
+    data[data.size() - 1] = char(data[data.size() - 1] ^ 0x55);
+    QVERIFY(file.seek(0));
+    QCOMPARE(file.write(data), qint64(data.size()));
+    file.close();
+    QVERIFY(!snapshot.open(path));
+}
+
+void RouteFileTest::parseLine_data()
+{
+    QTest::addColumn<QByteArray>("line");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<int>("stop_count");
+
+    QTest::newRow("path") << QByteArray("1路：甲(116.1,39.9)；乙(116.2,39.8)。2元。5分钟。30/分钟") << true << 2;
+    QTest::newRow("blanks and signs") << QByteArray("  1路：甲( 116.1 ,+39.9)；乙(116.2, 39.8)。 2元。5 分钟。30/分钟\r") << true << 2;
+    QTest::newRow("bad stops left out") << QByteArray("1路：甲(116.1,39.9)；乙116.2,39.8；丙(东,39.8)；；丁(116.3,39.7)。2元。5分钟。30/分钟") << true << 2;
+    QTest::newRow("no speed") << QByteArray("1路：甲(116.1,39.9)。2元。5分钟") << false << 0;
+    QTest::newRow("price out of range") << QByteArray("1路：甲(116.1,39.9)。200元。5分钟。30/分钟") << false << 0;
+    QTest::newRow("no stops") << QByteArray("1路：甲。2元。5分钟。30/分钟") << false << 0;
+    QTest::newRow("blank") << QByteArray("   ") << false << 0;
+}
+
+// A line is read straight from its bytes: names are decoded as UTF-8,
+// blanks around numbers are skipped, stops that cannot be read are left
+// out and a path with bad totals or no stops is rejected.
+void RouteFileTest::parseLine()
+{
+    QFETCH(QByteArray, line);
+    QFETCH(bool, ok);
+    QFETCH(int, stop_count);
+    RouteFile::Record record;
+    QCOMPARE(RouteFile::parseLine(std::string_view(line.constData(), line.size()), &record), ok);
+    if(!ok)return;
+    QCOMPARE(record.name, QString("1路"));
+    QCOMPARE(record.price, 2.0);
+    QCOMPARE(record.time, 5.0);
+    QCOMPARE(record.speed, 30.0);
+    QCOMPARE(int(record.stops.size()), stop_count);
+    QCOMPARE(record.stops[0].first, QString("甲"));
+    QCOMPARE(record.stops[0].second, RouteFile::posToPix(QPointF(116.1, 39.9)));
+}
+
+void RouteFileTest::parallelParser_data()
+{
+    QTest::addColumn<int>("thread_count");
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+}
+
+// A file of several blocks, split between threads, gives the records of
+// the serial parser in the same order.
+void RouteFileTest::parallelParser()
+{
+    QFETCH(int, thread_count);
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString path = dir.filePath("network.txt");
+    QByteArray text;
+    int valid = networkText(30000, 11, &text);
+    QVERIFY(text.size() > 2 * (1 << 20));
+    QVERIFY(writeFile(path, text));
+
+    QVector<RouteFile::Record> serial;
+    QVERIFY(readRecords(path, 1, &serial));
+    QCOMPARE(int(serial.size()), valid);
+    QCOMPARE(serial[0].name, QString("线路0"));
+    QVector<RouteFile::Record> parallel;
+    QVERIFY(readRecords(path, thread_count, &parallel));
+    QCOMPARE(parallel.size(), serial.size());
+    for(int i = 0; i < serial.size(); i++){
+        const RouteFile::Record &a = serial[i];
+        const RouteFile::Record &b = parallel[i];
+        QCOMPARE(b.name, a.name);
+        QCOMPARE(b.price, a.price);
+        QCOMPARE(b.time, a.time);
+        QCOMPARE(b.speed, a.speed);
+        QCOMPARE(b.stops.size(), a.stops.size());
+        for(int k = 0; k < a.stops.size(); k++){
+            QCOMPARE(b.stops[k].first, a.stops[k].first);
+            QCOMPARE(b.stops[k].second, a.stops[k].second);
+        }
+    }
+}
+// Each machine format holds the totals and legs of every answer, with the
+// fields quoted or escaped as the format needs.
+void RouteFileTest::answerFormats()
+{
+    RouteFile::Format format;
+    QVERIFY(RouteFile::parseFormat("jsonl", &format));
+    QCOMPARE(format, RouteFile::JsonLines);
+    QVERIFY(!RouteFile::parseFormat("xml", &format));
+    QCOMPARE(RouteFile::outputPath("queries.txt", RouteFile::Csv), QString("queries_routes_output.csv"));
+    QCOMPARE(RouteFile::outputPath("queries", RouteFile::Binary), QString("queries_routes_output.bin"));
+
+    QCOMPARE(writeAnswers(RouteFile::Csv), QByteArray(
+                 "query,strategy,start,end,reachable,price,time,distance,transfers,legs\n"
+                 "3,1,\"甲,东\",\"乙\"\"站\",1,2,12.5,3000,1,\"1路:甲,东>丙|步行:丙>乙\"\"站\"\n"
+                 "4,0,丁,丙,0,0,0,0,0,\n"));
+    QCOMPARE(writeAnswers(RouteFile::JsonLines), QByteArray(
+                 "{\"query\":3,\"strategy\":1,\"start\":\"甲,东\",\"end\":\"乙\\\"站\",\"reachable\":true,"
+                 "\"price\":2,\"time\":12.5,\"distance\":3000,\"transfers\":1,"
+                 "\"legs\":[{\"line\":\"1路\",\"from\":\"甲,东\",\"to\":\"丙\"},{\"line\":null,\"from\":\"丙\",\"to\":\"乙\\\"站\"}]}\n"
+                 "{\"query\":4,\"strategy\":0,\"start\":\"丁\",\"end\":\"丙\",\"reachable\":false,"
+                 "\"price\":0,\"time\":0,\"distance\":0,\"transfers\":0,\"legs\":[]}\n"));
+
+    QByteArray data = writeAnswers(RouteFile::Binary);
+    QCOMPARE(data.size(), 16 + 80 + 56);
+    QCOMPARE(data.left(8), QByteArray("ORANS\0\0\0", 8));
+    int pos = 8;
+    QCOMPARE(readField<quint32>(data, &pos), quint32(1));
+    QCOMPARE(readField<quint32>(data, &pos), quint32(0x01020304));
+    for(const RouteFile::Answer &answer : answers()){
+        QCOMPARE(readField<qint64>(data, &pos), answer.index);
+        QCOMPARE(readField<qint32>(data, &pos), answer.opt);
+        QCOMPARE(readField<qint32>(data, &pos), answer.S);
+        QCOMPARE(readField<qint32>(data, &pos), answer.T);
+        QCOMPARE(readField<qint32>(data, &pos), answer.cost.reachable ? 1 : 0);
+        QCOMPARE(readField<double>(data, &pos), answer.cost.price);
+        QCOMPARE(readField<double>(data, &pos), answer.cost.time);
+        QCOMPARE(readField<double>(data, &pos), answer.cost.distance);
+        QCOMPARE(readField<qint32>(data, &pos), qMax(answer.cost.transfer - 1, 0));
+        QCOMPARE(readField<qint32>(data, &pos), qint32(answer.legs.size()));
+        for(const RouteFile::Leg &leg : answer.legs){
+            QCOMPARE(readField<qint32>(data, &pos), leg.line);
+            QCOMPARE(readField<qint32>(data, &pos), leg.from);
+            QCOMPARE(readField<qint32>(data, &pos), leg.to);
+        }
+    }
+    QCOMPARE(pos, data.size());
+}
+/*** route file test end ***/
+
+QTEST_GUILESS_MAIN(RouteFileTest)
+
+#include "tst_routefile.moc"
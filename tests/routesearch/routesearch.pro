@@ -0,0 +1,27 @@
+QT       = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_routesearch
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_routesearch.cpp \
+    ../../routebatch.cpp \
+    ../../routecache.cpp \
+    ../../routegrid.cpp \
+    ../../routehierarchy.cpp \
+    ../../routenetwork.cpp \
+    ../../routeraptor.cpp \
+    ../../routesearch.cpp
+
+HEADERS += \
+    ../../routebatch.h \
+    ../../routecache.h \
+    ../../routegrid.h \
+    ../../routehierarchy.h \
+    ../../routenetwork.h \
+    ../../routeraptor.h \
+    ../../routesearch.h
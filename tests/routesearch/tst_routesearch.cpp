@@ -0,0 +1,383 @@
+#include "routenetwork.h"
+#include "routesearch.h"
+#include "routehierarchy.h"
+#include "routecache.h"
+#include "routebatch.h"
+#include "routeraptor.h"
+
+#include <QtTest>
+#include <cmath>
+#include <climits>
+#include <random>
+
+#define INF 1e18
+#define IINF ULLONG_MAX
+#define EPS 1e-6
+
+/*** route search test start ***/
+namespace{
+// Random stops on a 3000 by 3000 square and lines hopping forward through
+// them, drawn from seed so every run searches the same network. With walk
+// the stops of lines within 200 of each other are joined by footpaths.
+// Returns the stops some line serves.
+std::vector<int> buildNetwork(RouteNetwork *net, unsigned seed, bool walk)
+{
+    std::mt19937 rng(seed);
+    int stop_count = 300;
+    for(int i = 0; i < stop_count; i++){
+        net->addStop(rng() % 3000, rng() % 3000);
+    }
+    std::vector<char> served(stop_count, 0);
+    std::vector<int> ans;
+    for(int line = 0; line < 30; line++){
+        std::vector<int> stops;
+        int stop = rng() % stop_count;
+        for(int k = 0; k < 10; k++){
+            stops.push_back(stop);
+            if(!served[stop])ans.push_back(stop);
+            served[stop] = 1;
+            stop = (stop + 1 + rng() % 6) % stop_count;
+        }
+        net->addLine(1 + rng() % 5, 5 + rng() % 20, 1 + rng() % 3, stops);
+    }
+    if(walk){
+        net->setWalk(200, 0.5);
+    }
+    return ans;
+}
+
+// Pairs of distinct served stops drawn from seed, with every eighth end
+// drawn from all stop_count stops so some cannot be reached.
+std::vector<std::pair<int, int> > queries(unsigned seed, const std::vector<int> &stops, int stop_count)
+{
+    std::mt19937 rng(seed);
+    std::vector<std::pair<int, int> > ans;
+    while(ans.size() < 80){
+        int S = stops[rng() % stops.size()];
+        int T = ans.size() % 8 == 7 ? int(rng() % stop_count) : stops[rng() % stops.size()];
+        if(S != T)ans.push_back(std::make_pair(S, T));
+    }
+    return ans;
+}
+
+// Sum of the cheapest fixed-point edge weights along path, IINF for an
+// empty path. Routes of equal units are equally short to every search.
+unsigned long long pathUnits(const RouteNetwork::Graph &g, const std::vector<int> &path)
+{
+    if(path.empty())return IINF;
+    unsigned long long w = 0;
+    for(size_t k = 0; k + 1 < path.size(); k++){
+        unsigned long long best = IINF;
+        for(int i = g.offset[path[k]]; i < g.offset[path[k] + 1]; i++){
+            if(g.target[i] == path[k + 1])best = qMin(best, g.iweight[i]);
+        }
+        w += best;
+    }
+    return w;
+}
+
+// Cost of a round based route under opt: every boarding pays the price or
+// the fixed time of its line, riding and walking take their length over
+// the speed.
+double routeCost(RouteNetwork *net, const std::vector<std::pair<int, int> > &route, int opt)
+{
+    double cost = 0;
+    int last_line = -1;
+    int last_stop = -1;
+    for(const std::pair<int, int> &p : route){
+        if(p.second < 0){
+            if(last_stop >= 0 && opt != 0)cost += net->distance(last_stop, p.first) / net->getWalkSpeed();
+        }
+        else{
+            const RouteNetwork::Line &line = net->getLine(p.second);
+            if(p.second != last_line || p.first == last_stop)cost += opt == 0 ? line.price : opt == 2 ? line.time : 0;
+            else if(opt != 0)cost += net->distance(last_stop, p.first) / line.speed;
+        }
+        last_line = p.second;
+        last_stop = p.first;
+    }
+    return cost;
+}
+
+// A cost weighed in real units against the cost of a shortest route in
+// fixed-point units, which rounds each weight of a route up by less than a
+// unit, so it is never below and at most edges units above.
+bool nearCost(double cost, double reference, size_t edges, double scale)
+{
+    if(cost >= INF || reference >= INF)return cost >= INF && reference >= INF;
+    return cost <= reference + EPS && reference <= cost + edges / scale + EPS;
+}
+
+bool validPath(const std::vector<int> &path, int S, int T)
+{
+    return !path.empty() && path.front() == S && path.back() == T;
+}
+}
+
+// Every engine is checked against a full plain Dijkstra search from the
+// start on the same network.
+class RouteSearchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void engines_data();
+    void engines();
+    void batch_data();
+    void batch();
+    void pareto_data();
+    void pareto();
+    void raptorReuse();
+};
+
+void RouteSearchTest::engines_data()
+{
+    QTest::addColumn<int>("opt");
+    QTest::addColumn<bool>("walk");
+    for(int opt = 0; opt < 3; opt++){
+        QTest::addRow("strategy %d", opt) << opt << false;
+        QTest::addRow("strategy %d, walking", opt) << opt << true;
+    }
+}
+
+void RouteSearchTest::engines()
+{
+    QFETCH(int, opt);
+    QFETCH(bool, walk);
+    RouteNetwork net;
+    std::vector<int> stops = buildNetwork(&net, 1, walk);
+    const RouteNetwork::Graph &g = net.getGraph(opt);
+    RouteSearch reference;
+    reference.setNetwork(&net, opt);
+    RouteSearch search;
+    search.setNetwork(&net, opt);
+    RouteHierarchy hierarchy;
+    if(opt != 0)hierarchy.build(&net, opt);
+    RouteTreeCache trees;
+    RouteRaptor raptor;
+    raptor.setNetwork(&net, opt);
+    std::vector<std::pair<int, int> > list = queries(2, stops, net.getStopCount());
+    std::vector<int> sources;
+    std::vector<int> targets;
+    int reachable = 0;
+    for(const std::pair<int, int> &q : list){
+        int S = q.first;
+        int T = q.second;
+        reference.dijkstra(S);
+        double expected = reference.getDistance(T);
+        if(expected < INF)reachable++;
+
+        std::vector<int> path;
+        reference.findPath(T, &path);
+        QVERIFY(expected >= INF || validPath(path, S, T));
+        unsigned long long units = pathUnits(g, path);
+        QCOMPARE(units == IINF ? INF : units / g.scale, expected);
+        size_t edges = path.size();
+
+        QCOMPARE(search.dijkstra(S, T), expected);
+        search.findPath(T, &path);
+        QCOMPARE(pathUnits(g, path), units);
+
+        QCOMPARE(search.bidirectional(S, T, &path), expected);
+        QVERIFY(expected >= INF || validPath(path, S, T));
+        QCOMPARE(pathUnits(g, path), units);
+
+        QCOMPARE(search.astar(S, T), expected);
+        search.findPath(T, &path);
+        QCOMPARE(pathUnits(g, path), units);
+
+        if(opt != 0){
+            QCOMPARE(search.hierarchy(hierarchy, S, T, &path), expected);
+            QVERIFY(expected >= INF || validPath(path, S, T));
+            QCOMPARE(pathUnits(g, path), units);
+        }
+
+        // a tree answers a query once its start or end repeats
+        QVERIFY(!RouteTreeCache().route(&net, search, opt, S, T, &path));
+        trees.route(&net, search, opt, S, T, &path);
+        QVERIFY(trees.route(&net, search, opt, S, T, &path));
+        QCOMPARE(path.empty(), expected >= INF);
+        QCOMPARE(pathUnits(g, path), units);
+        RouteTreeCache ends;
+        QVERIFY(!ends.route(&net, search, opt, T, T, &path));
+        QVERIFY(ends.route(&net, search, opt, S, T, &path));
+        QVERIFY(expected >= INF || validPath(path, S, T));
+        QCOMPARE(pathUnits(g, path), units);
+
+        // the ranked routes start with a shortest one and never get cheaper,
+        // also when the exact distances of the tree into T steer them; a new
+        // end has no tree
+        QVERIFY(RouteTreeCache().target(&net, search, opt, T) == nullptr);
+        const RouteTreeCache::Tree *tree = ends.target(&net, search, opt, T);
+        QVERIFY(tree != nullptr);
+        for(int steered = 0; steered < 2; steered++){
+            std::vector<std::vector<int> > paths;
+            search.setPotential(steered ? &tree->dist : nullptr);
+            search.kShortest(S, T, 5, &paths);
+            QCOMPARE(paths.empty(), expected >= INF);
+            for(size_t k = 0; k < paths.size(); k++){
+                QVERIFY(validPath(paths[k], S, T));
+                if(k == 0)QCOMPARE(pathUnits(g, paths[k]), units);
+                else QVERIFY(pathUnits(g, paths[k]) >= pathUnits(g, paths[k - 1]));
+            }
+        }
+        search.setPotential(nullptr);
+
+        // the last round based route is the one with the most boardings,
+        // which is the cheapest; rounds weigh routes in real units
+        std::vector<std::vector<std::pair<int, int> > > routes;
+        raptor.query(S, T, &routes);
+        QCOMPARE(routes.empty(), expected >= INF);
+        if(!routes.empty()){
+            QCOMPARE(routes.back().front().first, S);
+            QCOMPARE(routes.back().back().first, T);
+            QVERIFY(nearCost(routeCost(&net, routes.back(), opt), expected, edges, g.scale));
+        }
+
+        if(sources.size() < 8)sources.push_back(S);
+        if(targets.size() < 8)targets.push_back(T);
+    }
+    QVERIFY(reachable > 0);
+
+    std::vector<RouteNetwork::Cost> costs;
+    search.matrix(sources, targets, &costs);
+    QCOMPARE(int(costs.size()), int(sources.size() * targets.size()));
+    for(size_t i = 0; i < sources.size(); i++){
+        reference.dijkstra(sources[i]);
+        std::vector<std::vector<int> > paths;
+        search.routes(sources[i], targets, &paths);
+        QCOMPARE(paths.size(), targets.size());
+        for(size_t j = 0; j < targets.size(); j++){
+            const RouteNetwork::Cost &cost = costs[i * targets.size() + j];
+            std::vector<int> path;
+            reference.findPath(targets[j], &path);
+            double expected = reference.getDistance(targets[j]);
+            QCOMPARE(cost.reachable, expected < INF);
+            if(cost.reachable)QVERIFY(nearCost(opt == 0 ? cost.price : cost.time, expected, path.size(), g.scale));
+            QCOMPARE(paths[j].empty(), expected >= INF);
+            QCOMPARE(pathUnits(g, paths[j]), pathUnits(g, path));
+        }
+    }
+}
+
+void RouteSearchTest::batch_data()
+{
+    QTest::addColumn<bool>("contracted");
+    QTest::newRow("searches") << false;
+    QTest::newRow("hierarchies") << true;
+}
+
+// A batch of every strategy on several threads gives each query a route as
+// cheap as Dijkstra, in the order asked.
+void RouteSearchTest::batch()
+{
+    QFETCH(bool, contracted);
+    RouteNetwork net;
+    std::vector<int> stops = buildNetwork(&net, 3, true);
+    RouteHierarchy hierarchy[3];
+    RouteBatch batch;
+    batch.setNetwork(&net);
+    batch.setThreadCount(4);
+    if(contracted){
+        for(int opt = 1; opt < 3; opt++){
+            hierarchy[opt].build(&net, opt);
+            batch.setHierarchy(opt, &hierarchy[opt]);
+        }
+    }
+    std::vector<std::pair<int, int> > list = queries(4, stops, net.getStopCount());
+    std::vector<RouteBatch::Query> batch_queries;
+    for(size_t i = 0; i < list.size(); i++){
+        // repeated starts share one search
+        int S = i % 4 == 0 ? list[0].first : list[i].first;
+        if(S == list[i].second)continue;
+        batch_queries.push_back(RouteBatch::Query{int(i % 3), S, list[i].second});
+    }
+    std::vector<std::vector<int> > paths;
+    QVERIFY(batch.run(batch_queries, &paths));
+    QCOMPARE(paths.size(), batch_queries.size());
+    RouteSearch reference[3];
+    for(int opt = 0; opt < 3; opt++){
+        reference[opt].setNetwork(&net, opt);
+    }
+    for(size_t i = 0; i < batch_queries.size(); i++){
+        const RouteBatch::Query &q = batch_queries[i];
+        double expected = reference[q.opt].dijkstra(q.S, q.T);
+        std::vector<int> path;
+        reference[q.opt].findPath(q.T, &path);
+        QCOMPARE(paths[i].empty(), expected >= INF);
+        if(!paths[i].empty()){
+            QVERIFY(validPath(paths[i], q.S, q.T));
+            QCOMPARE(pathUnits(net.getGraph(q.opt), paths[i]), pathUnits(net.getGraph(q.opt), path));
+        }
+    }
+}
+
+void RouteSearchTest::pareto_data()
+{
+    QTest::addColumn<bool>("walk");
+    QTest::newRow("riding") << false;
+    QTest::newRow("walking") << true;
+}
+
+// The routes not beaten on price, time and transfers include one as cheap
+// as the price strategy and one as fast as the time strategy.
+void RouteSearchTest::pareto()
+{
+    QFETCH(bool, walk);
+    RouteNetwork net;
+    std::vector<int> stops = buildNetwork(&net, 5, walk);
+    RouteSearch search;
+    search.setNetwork(&net, 2);
+    RouteSearch reference[3];
+    reference[0].setNetwork(&net, 0);
+    reference[2].setNetwork(&net, 2);
+    std::vector<std::pair<int, int> > list = queries(6, stops, net.getStopCount());
+    list.resize(20);
+    for(const std::pair<int, int> &q : list){
+        std::vector<std::vector<int> > paths;
+        search.pareto(q.first, q.second, &paths);
+        double time = reference[2].dijkstra(q.first, q.second);
+        QCOMPARE(paths.empty(), time >= INF);
+        if(paths.empty())continue;
+        reference[0].dijkstra(q.first, q.second);
+        std::vector<int> best;
+        reference[0].findPath(q.second, &best);
+        unsigned long long price = pathUnits(net.getGraph(0), best);
+        reference[2].findPath(q.second, &best);
+        unsigned long long fastest = pathUnits(net.getGraph(2), best);
+        unsigned long long best_price = IINF;
+        unsigned long long best_time = IINF;
+        for(const std::vector<int> &path : paths){
+            QVERIFY(validPath(path, q.first, q.second));
+            best_price = qMin(best_price, pathUnits(net.getGraph(0), path));
+            best_time = qMin(best_time, pathUnits(net.getGraph(2), path));
+        }
+        QCOMPARE(best_price, price);
+        QCOMPARE(best_time, fastest);
+    }
+}
+
+// A router answers queries back to back after a single setNetwork as a
+// fresh router answers each of them.
+void RouteSearchTest::raptorReuse()
+{
+    RouteNetwork net;
+    std::vector<int> stops = buildNetwork(&net, 7, true);
+    std::vector<std::pair<int, int> > list = queries(8, stops, net.getStopCount());
+    RouteRaptor raptor;
+    raptor.setNetwork(&net, 2);
+    for(const std::pair<int, int> &q : list){
+        std::vector<std::vector<std::pair<int, int> > > routes;
+        raptor.query(q.first, q.second, &routes);
+        RouteRaptor fresh;
+        fresh.setNetwork(&net, 2);
+        std::vector<std::vector<std::pair<int, int> > > expected;
+        fresh.query(q.first, q.second, &expected);
+        QVERIFY(routes == expected);
+    }
+}
+/*** route search test end ***/
+
+QTEST_GUILESS_MAIN(RouteSearchTest)
+
+#include "tst_routesearch.moc"
@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+# Run with "make check" from the build directory of this file.
+SUBDIRS += \
+    routefile \
+    routesearch